@@ -0,0 +1,178 @@
+import glob
+import os
+import re
+import sys
+import time
+
+import numpy as np
+from scipy.io import wavfile
+
+from calibrate import NOTE_TABLE_HEADER, PitchModel, write_note_table
+
+AUTO_TUNE_START_US = 1100
+AUTO_TUNE_END_US = 1400
+AUTO_TUNE_STEP_US = 10
+AUTO_TUNE_PASSES = 2
+RECORD_SECONDS = 1.0
+SAMPLE_RATE = 44100
+
+# Pitch detection
+MIN_FREQ = 50
+MAX_FREQ = 2000
+FRAME_SIZE = 2048
+HOP_SIZE = 512
+ATTACK_SKIP_S = 0.05    # skip the pick transient
+YIN_THRESHOLD = 0.15
+
+
+def load_wav(path: str):
+    rate, samples = wavfile.read(path)
+    samples = samples.astype(np.float64)
+    if samples.ndim > 1:
+        samples = samples.mean(axis=1)
+    return rate, samples
+
+
+def yin(samples, rate: int):
+    """
+    Estimate the fundamental of a recording with YIN. All frames are processed
+    at once: the difference function comes from an FFT autocorrelation, so the
+    cost is O(frames * N log N) with no per-lag Python loop.
+    Returns the median frequency over voiced frames, or None if none are voiced.
+    """
+    samples = samples[int(ATTACK_SKIP_S * rate):]
+    samples = samples - samples.mean()
+    if len(samples) < FRAME_SIZE:
+        return None
+
+    n_frames = 1 + (len(samples) - FRAME_SIZE) // HOP_SIZE
+    idx = np.arange(FRAME_SIZE)[None, :] + HOP_SIZE * np.arange(n_frames)[:, None]
+    frames = samples[idx]
+
+    max_lag = min(int(rate / MIN_FREQ), FRAME_SIZE // 2)
+    min_lag = max(int(rate / MAX_FREQ), 2)
+    window = FRAME_SIZE - max_lag
+
+    # d(tau) = sum x[j]^2 + sum x[j+tau]^2 - 2 sum x[j]x[j+tau], j over the window
+    spectrum_size = 1 << int(np.ceil(np.log2(FRAME_SIZE + window)))
+    head = np.fft.rfft(frames[:, :window], spectrum_size)
+    full = np.fft.rfft(frames, spectrum_size)
+    corr = np.fft.irfft(np.conj(head) * full, spectrum_size)[:, :max_lag]
+
+    energy = np.cumsum(frames ** 2, axis=1)
+    energy = np.concatenate([np.zeros((n_frames, 1)), energy], axis=1)
+    lags = np.arange(max_lag)
+    shifted = energy[:, lags + window] - energy[:, lags]
+    diff = energy[:, window][:, None] + shifted - 2 * corr
+
+    # Cumulative mean normalized difference
+    cmnd = np.ones_like(diff)
+    cumulative = np.cumsum(diff[:, 1:], axis=1)
+    cmnd[:, 1:] = diff[:, 1:] * lags[1:] / np.where(cumulative == 0, 1, cumulative)
+
+    # First dip under the threshold, else the global minimum, in the allowed lag range
+    search = cmnd[:, min_lag:]
+    below = search < YIN_THRESHOLD
+    first = np.where(below.any(axis=1), below.argmax(axis=1), search.argmin(axis=1))
+    # Walk to the bottom of the dip
+    tau = first + min_lag
+    for _ in range(max_lag):
+        step = (tau + 1 < max_lag) & (cmnd[np.arange(n_frames), np.minimum(tau + 1, max_lag - 1)] <
+                                      cmnd[np.arange(n_frames), tau])
+        if not step.any():
+            break
+        tau = tau + step
+
+    rows = np.arange(n_frames)
+    voiced = cmnd[rows, tau] < YIN_THRESHOLD * 2
+    if not voiced.any():
+        return None
+
+    # Parabolic interpolation around the dip
+    left = cmnd[rows, np.maximum(tau - 1, 0)]
+    mid = cmnd[rows, tau]
+    right = cmnd[rows, np.minimum(tau + 1, max_lag - 1)]
+    denom = left - 2 * mid + right
+    offset = np.where(np.abs(denom) > 1e-12, 0.5 * (left - right) / np.where(denom == 0, 1, denom), 0)
+    period = tau + offset
+
+    return float(np.median(rate / period[voiced]))
+
+
+def capture_name(group: int, pwm: int):
+    return f'{group}_{pwm}.wav'
+
+
+def load_captures(directory: str):
+    # Files are named <group>_<pwm>.wav, or <pwm>.wav for a single sweep
+    captures = []
+    for path in glob.glob(os.path.join(directory, '*.wav')):
+        match = re.fullmatch(r'(?:(\d+)_)?(\d+)\.wav', os.path.basename(path))
+        if match:
+            group = int(match.group(1) or 0)
+            captures.append((group, int(match.group(2)), path))
+    return sorted(captures)
+
+
+def record_sweep(directory: str, uart_send, debug=False):
+    # Step the pitch servo over the range, pick once per step and record the string
+    import sounddevice
+
+    os.makedirs(directory, exist_ok=True)
+    for group in range(AUTO_TUNE_PASSES):
+        # Approach from below every pass so the groups stay comparable
+        uart_send(f'pitch set pulse width us {AUTO_TUNE_START_US}\r', debug=debug)
+        time.sleep(0.5)
+        for pwm in range(AUTO_TUNE_START_US, AUTO_TUNE_END_US + 1, AUTO_TUNE_STEP_US):
+            uart_send(f'pitch set pulse width us {pwm}\r', debug=debug)
+            time.sleep(0.1)
+            recording = sounddevice.rec(int(RECORD_SECONDS * SAMPLE_RATE), samplerate=SAMPLE_RATE, channels=1)
+            uart_send('pick\r', debug=debug)
+            sounddevice.wait()
+            wavfile.write(os.path.join(directory, capture_name(group, pwm)), SAMPLE_RATE, recording[:, 0])
+
+
+def analyze_captures(directory: str, data_csv: str = 'pwm_freq_data.csv'):
+    # Detect the pitch of every capture and write them in the format tune_result() reads
+    measurements = []
+    for group, pwm, path in load_captures(directory):
+        rate, samples = load_wav(path)
+        freq = yin(samples, rate)
+        if freq is None:
+            print(f"\033[93m No pitch found in {path}\033[0m")
+            continue
+        measurements.append((group, pwm, freq))
+
+    with open(data_csv, 'w', encoding='utf-8') as f:
+        for _, pwm, freq in measurements:
+            f.write(f"{pwm},{freq:.1f}\n")
+    return measurements
+
+
+def auto_tune(directory: str, uart_send=None, debug=False, data_csv: str = 'pwm_freq_data.csv'):
+    if uart_send is not None:
+        record_sweep(directory, uart_send, debug=debug)
+
+    begin = time.perf_counter()
+    measurements = analyze_captures(directory, data_csv)
+    if not measurements:
+        print("\033[91mNo usable captures\033[0m")
+        return None
+    # Same isotonic fit and header as calibrate.py, so the board plays what was measured
+    try:
+        model = PitchModel.from_csv(data_csv)
+    except ValueError as e:
+        print(f"\033[91m{e}\033[0m")
+        return None
+    write_note_table(model, source=data_csv)
+    table = {note: model.pwm_of(note) for note in model.playable_notes()}
+    print(f"Analyzed {len(measurements)} captures in {time.perf_counter() - begin:.2f}s, "
+          f"wrote {len(table)} notes to {NOTE_TABLE_HEADER}")
+    return table
+
+
+if __name__ == "__main__":
+    # Usage: python autotune.py <capture directory>
+    table = auto_tune(sys.argv[1])
+    if table:
+        print("NOTE_TO_PWM =", table)
@@ -0,0 +1,546 @@
+/*
+ * File:   isr_bench.c
+ *
+ * ISR latency and RX throughput benchmark. main.c and utils/ are built
+ * natively against the mocked SFRs in bench/mock, then driven byte by byte
+ * the way the UART would drive them. Time is virtual: UART TX waits and
+ * __delay calls advance it, and so does every firmware and library call by
+ * its estimated cost in the cycle model below. TMR1 counts along with it.
+ * The output is identical on every machine, so CI can diff it against
+ * bench/isr_bench.txt.
+ *
+ * Build and run with `make bench`, compare with `make bench-check`.
+ */
+
+#undef main
+
+#include <xc.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "../utils/config.h"
+#include "../utils/ccp.h"
+#include "../utils/interrupt_manager.h"
+#include "../utils/latency_table.h"
+#include "../utils/timer.h"
+
+#define RX_FIFO_SIZE 2          // RCREG is two bytes deep, the next byte sets OERR
+#define MAX_ARRIVALS 4096
+#define MAX_PICKS 16
+#define MAX_PITCH_WRITES 64
+#define BYTE_US (10UL * 1000000UL / UART_BAUD_RATE)
+#define TCY_PER_US (_XTAL_FREQ / 4000000.0)
+
+// firmware entry points and state, see main.c
+void SystemInitialize(void);
+void HighIsr(void);
+void LowIsr(void);
+void service_button(void);
+void UartClearBuffer(void);
+void UartTxPoll(void);
+unsigned char UartTxPending(void);
+extern unsigned int pending_notes;
+extern unsigned int pending_code;
+extern unsigned char pick_state;
+
+unsigned long long now_us = 0;
+unsigned long long tx_free_us = 0;
+unsigned long tx_bytes = 0;
+unsigned long long ccp_write_us[3] = {0};
+volatile unsigned char ccp_register[3];
+
+// Servo physics for the onset checks: ~0.1s per 60 degrees over 500~2400us, applied to the
+// pulse widths the firmware wrote. Deliberately not latency_table.h, which is what they check
+#define SERVO_US_PER_MS 6.3
+#define SERVO_SETTLE_MS 5
+#define DUTY_STEP_US (16 * 1000000.0 / _XTAL_FREQ)     // one CCPRxL:DCxB step at Timer2 prescaler 16
+
+// every pick and pitch servo write while recording, with the duty value it moved from
+int recording_picks = 0;
+int pick_count = 0;
+unsigned long long pick_us[MAX_PICKS];
+unsigned int pick_from[MAX_PICKS];
+int pitch_count = 0;
+unsigned long long pitch_us[MAX_PITCH_WRITES];
+unsigned int pitch_from[MAX_PITCH_WRITES];
+
+unsigned char rx_fifo[RX_FIFO_SIZE];
+int rx_count = 0;
+unsigned long rx_lost = 0;
+
+unsigned char arrival_byte[MAX_ARRIVALS];
+unsigned long long arrival_us[MAX_ARRIVALS];
+int arrival_count = 0;
+int arrival_next = 0;
+
+/* ---- cycle model ---- */
+
+// The firmware is built with -finstrument-functions, so every call into it lands in
+// __cyg_profile_func_enter, and the library calls it makes are linked through --wrap.
+// Each charges its Tcy below to virtual time. These are estimates, not measurements:
+// CALL/RETURN and frame moves for a plain call, context save for the ISRs, and rough
+// XC8 soft-float, long division and printf/scanf routine costs where those run
+#define CALL_TCY 20
+#define STRING_BYTE_TCY 8       // load, compare and branch per byte of strcmp/strncmp
+
+typedef struct {
+    void *function;
+    unsigned int tcy;
+} CallCost;
+
+// part of a us charged but not yet on now_us, 0 at 4MHz where 1 Tcy is 1 us
+double charged_us_fraction = 0;
+
+void ChargeTcy(unsigned long tcy){
+    double us = tcy / TCY_PER_US + charged_us_fraction;
+    now_us += (unsigned long long)us;
+    charged_us_fraction = us - (unsigned long long)us;
+}
+
+void __cyg_profile_func_enter(void *function, void *call_site){
+    (void)call_site;
+    static const CallCost costs[] = {
+        {(void *)LowIsr, 60},                   // software save of WREG, STATUS, BSR, FSRs, PROD, TBLPTR
+        {(void *)HighIsr, 30},                  // fast register stack, compiler temporaries only
+        {(void *)Motor2RotateDegree, 1400},     // int to float, float multiply, divide and add
+        {(void *)MotorRotateDegree, 1400},
+        {(void *)PWM2SetDutyCycle, 900},        // float multiply and divide, float to long long
+        {(void *)PWMSetDutyCycle, 900},
+        {(void *)PWMSetDutyValue, 600},         // unsigned to float, float multiply and divide
+        {(void *)PWMDutyValueFromUs, 250},      // 32 bit multiply and divide
+        {(void *)PWMDutyValueToUs, 250},
+        {(void *)Timer1GetMillis, 300},         // 32 bit divide and modulo
+    };
+    for(unsigned int i = 0; i < sizeof(costs) / sizeof(costs[0]); i++){
+        if(costs[i].function == function){
+            ChargeTcy(costs[i].tcy);
+            return;
+        }
+    }
+    ChargeTcy(CALL_TCY);
+}
+
+void __cyg_profile_func_exit(void *function, void *call_site){
+    (void)function;
+    (void)call_site;
+}
+
+int __real_strcmp(const char *a, const char *b);
+int __real_strncmp(const char *a, const char *b, size_t n);
+
+unsigned long CompareTcy(const char *a, const char *b, size_t n){
+    size_t i = 0;
+    while(i < n && a[i] && a[i] == b[i]) i++;
+    return CALL_TCY + (i + 1) * STRING_BYTE_TCY;
+}
+
+int __wrap_strcmp(const char *a, const char *b){
+    ChargeTcy(CompareTcy(a, b, (size_t)-1));
+    return __real_strcmp(a, b);
+}
+
+int __wrap_strncmp(const char *a, const char *b, size_t n){
+    ChargeTcy(CompareTcy(a, b, n));
+    return __real_strncmp(a, b, n);
+}
+
+// glibc links sscanf as __isoc99_sscanf, both are wrapped
+int __wrap_sscanf(const char *str, const char *format, ...){
+    ChargeTcy(1500);                            // format walk plus a %d conversion
+    va_list args;
+    va_start(args, format);
+    int matched = vsscanf(str, format, args);
+    va_end(args);
+    return matched;
+}
+
+int __wrap___isoc99_sscanf(const char *str, const char *format, ...){
+    ChargeTcy(1500);
+    va_list args;
+    va_start(args, format);
+    int matched = vsscanf(str, format, args);
+    va_end(args);
+    return matched;
+}
+
+int __wrap_sprintf(char *str, const char *format, ...){
+    ChargeTcy(1200);                            // %d/%u/%ld, division by 10 per digit
+    va_list args;
+    va_start(args, format);
+    int length = vsprintf(str, format, args);
+    va_end(args);
+    return length;
+}
+
+/* ---- mock hooks ---- */
+
+void MockWaitUs(unsigned long us){
+    now_us += us;
+}
+
+volatile unsigned char *MockTxRegister(void){
+    // the shift register must be empty before the next byte is loaded
+    if(now_us < tx_free_us) now_us = tx_free_us;
+    tx_free_us = now_us + BYTE_US;
+    tx_bytes++;
+    static volatile unsigned char txreg;
+    return &txreg;
+}
+
+MockBits *MockTxStatus(void){
+    static MockBits txsta;
+    txsta.TRMT = now_us >= tx_free_us;
+    return &txsta;
+}
+
+void DeliverArrivals(void){
+    while(arrival_next < arrival_count && arrival_us[arrival_next] <= now_us){
+        if(rx_count < RX_FIFO_SIZE){
+            rx_fifo[rx_count++] = arrival_byte[arrival_next];
+        } else {
+            rx_lost++;
+            RCSTAbits.OERR = 1;
+        }
+        arrival_next++;
+    }
+    RCIF = rx_count > 0;
+}
+
+unsigned char MockRxRead(void){
+    DeliverArrivals();
+    if(rx_count == 0) return 0;
+    unsigned char byte = rx_fifo[0];
+    rx_count--;
+    memmove(rx_fifo, rx_fifo + 1, rx_count);
+    // the firmware clears OERR by toggling CREN, which the mock cannot see
+    RCSTAbits.OERR = 0;
+    RCIF = rx_count > 0;
+    return byte;
+}
+
+unsigned int DutyValue(unsigned char module){
+    return ccp_register[module] * 4 + (module == 1 ? CCP1CONbits.DC1B : CCP2CONbits.DC2B);
+}
+
+volatile unsigned char *MockCcpRegister(unsigned char module){
+    ccp_write_us[module] = now_us;
+    // CCPRxL is written before DCxB, both still hold the old duty value here
+    if(module == 2 && recording_picks && pick_count < MAX_PICKS){
+        pick_us[pick_count] = now_us;
+        pick_from[pick_count++] = DutyValue(2);
+    }
+    if(module == 1 && recording_picks && pitch_count < MAX_PITCH_WRITES){
+        pitch_us[pitch_count] = now_us;
+        pitch_from[pitch_count++] = DutyValue(1);
+    }
+    return &ccp_register[module];
+}
+
+volatile unsigned int *MockTimer1(void){
+    // free running from reset, counts Tcy through the T1CKPS prescaler. Like the hardware
+    // flag, TMR1IF only says some wrap happened since it was cleared, not how many
+    static volatile unsigned int tmr1;
+    static unsigned long long wraps_seen = 0;
+    unsigned long long ticks = (unsigned long long)(now_us * TCY_PER_US / (1 << T1CONbits.T1CKPS));
+    if(ticks >> 16 != wraps_seen){
+        wraps_seen = ticks >> 16;
+        PIR1bits.TMR1IF = 1;
+    }
+    tmr1 = (unsigned int)(ticks & 0xFFFF);
+    return &tmr1;
+}
+
+/* ---- helpers ---- */
+
+// main()'s loop, sends queued bytes as the transmitter frees up until `until_us`
+void DrainTx(unsigned long long until_us){
+    while(UartTxPending() && tx_free_us <= until_us){
+        if(now_us < tx_free_us) now_us = tx_free_us;
+        UartTxPoll();
+    }
+}
+
+void Idle(void){
+    // let the last reply drain, the host waits for it before sending more
+    DrainTx(~0ULL);
+    if(now_us < tx_free_us) now_us = tx_free_us;
+}
+
+// Nothing arrives for `us`, LowIsr still takes the Timer1 overflow interrupts
+void IdleFor(unsigned long long us){
+    unsigned long long end = now_us + us;
+    DrainTx(end);
+    while(now_us < end){
+        now_us += end - now_us < 100000 ? end - now_us : 100000;
+        (void)TMR1;
+        if(Timer1IF) LowIsr();
+    }
+}
+
+void ResetArrivals(void){
+    arrival_count = 0;
+    arrival_next = 0;
+    rx_count = 0;
+    rx_lost = 0;
+    RCSTAbits.OERR = 0;
+    RCIF = 0;
+}
+
+void QueueBytes(const unsigned char *data, int length, unsigned long long start_us, double gap_us){
+    for(int i = 0; i < length && arrival_count < MAX_ARRIVALS; i++){
+        arrival_byte[arrival_count] = data[i];
+        arrival_us[arrival_count] = start_us + (unsigned long long)(i * gap_us);
+        arrival_count++;
+    }
+}
+
+// Runs LowIsr whenever a byte is waiting, until every queued byte is consumed
+void RunRx(unsigned long *entries, unsigned long long *total_us, unsigned long long *max_entry_us){
+    while(1){
+        DeliverArrivals();
+        if(rx_count == 0){
+            if(arrival_next == arrival_count) break;
+            DrainTx(arrival_us[arrival_next]);
+            if(now_us < arrival_us[arrival_next]) now_us = arrival_us[arrival_next];
+            continue;
+        }
+        unsigned long long start = now_us;
+        LowIsr();
+        unsigned long long spent = now_us - start;
+        if(entries) (*entries)++;
+        if(total_us) *total_us += spent;
+        if(max_entry_us && spent > *max_entry_us) *max_entry_us = spent;
+    }
+}
+
+/* ---- benchmarks ---- */
+
+// One command as the host sends it, at wire speed after the previous reply
+void BenchCommand(const char *label, const char *command, int length){
+    Idle();
+    ResetArrivals();
+    unsigned long first_tx = tx_bytes;
+    unsigned long entries = 0;
+    unsigned long long total_us = 0, max_entry_us = 0;
+
+    QueueBytes((const unsigned char *)command, length, now_us, BYTE_US);
+    RunRx(&entries, &total_us, &max_entry_us);
+    Idle();
+    printf("%-40s %5d %7lu %12llu %12llu %7lu\n", label, length, entries,
+           total_us, max_entry_us, tx_bytes - first_tx);
+}
+
+// Time from the trigger to the pick servo's CCPR2L write, and until the ISR returns.
+// The string is heard the pick lag from latency_table.h after the write
+void PrintServoLatency(const char *label, unsigned long long trigger_us, unsigned long first_tx, unsigned int pick_lag){
+    unsigned long long returned_us = now_us;
+    Idle();
+    printf("%-40s %12llu %12llu %7lu %10llu\n", label, ccp_write_us[2] - trigger_us,
+           returned_us - trigger_us, tx_bytes - first_tx, (ccp_write_us[2] - trigger_us) / 1000 + pick_lag);
+}
+
+void BenchButton(void){
+    Idle();
+    unsigned long first_tx = tx_bytes;
+    unsigned long long start = now_us;
+    INTCONbits.INT0IE = 1;
+    INTCONbits.INT0IF = 1;
+    unsigned int pick_lag = pick_state ? LATENCY_PICK_RISE_MS : LATENCY_PICK_FALL_MS;
+    // HighIsr flags the press, the next pass of main()'s loop picks
+    HighIsr();
+    service_button();
+    PrintServoLatency("button (INT0, main loop)", start, first_tx, pick_lag);
+}
+
+void BenchLiveNote(void){
+    Idle();
+    ResetArrivals();
+    unsigned long first_tx = tx_bytes;
+    QueueBytes((const unsigned char *)"\x90\x3c", 2, now_us, BYTE_US);
+    unsigned int pick_lag = pick_state ? LATENCY_PICK_RISE_MS : LATENCY_PICK_FALL_MS;
+    RunRx(NULL, NULL, NULL);
+    PrintServoLatency("live note on (LowIsr)", arrival_us[1], first_tx, pick_lag);
+}
+
+// Brings the firmware into a known state without reporting anything,
+// `commands` may hold several lines, each is sent after the previous reply
+void BenchSetup(const char *commands){
+    pending_notes = 0;
+    pending_code = 0;
+    UartClearBuffer();
+    while(commands != NULL && *commands != '\0'){
+        const char *end = strchr(commands, '\r');
+        int length = end ? (int)(end - commands + 1) : (int)strlen(commands);
+        Idle();
+        ResetArrivals();
+        QueueBytes((const unsigned char *)commands, length, now_us, BYTE_US);
+        RunRx(NULL, NULL, NULL);
+        commands += length;
+    }
+}
+
+// Streams `count` copies of `pattern` at `rate` bytes/s without waiting for replies
+unsigned long StreamLost(const char *pattern, int length, int count, double rate){
+    Idle();
+    ResetArrivals();
+    unsigned long long start = now_us;
+    for(int i = 0; i < count; i++){
+        QueueBytes((const unsigned char *)pattern, length, start + (unsigned long long)(i * length * 1e6 / rate), 1e6 / rate);
+    }
+    RunRx(NULL, NULL, NULL);
+    return rx_lost;
+}
+
+// Highest rate (bytes/s, up to the wire limit) that streams without a lost byte
+void BenchStream(const char *label, const char *setup, const char *pattern, int length, int count){
+    double wire_rate = 1e6 / BYTE_US;
+    double low = 1, high = wire_rate;
+
+    for(int i = 0; i < 20; i++){
+        double rate = (low + high) / 2;
+        BenchSetup(setup);
+        if(StreamLost(pattern, length, count, rate) == 0) low = rate;
+        else high = rate;
+    }
+    BenchSetup(setup);
+    unsigned long lost_at_wire = StreamLost(pattern, length, count, wire_rate);
+    printf("%-40s %10.1f %6.1f%% %12lu\n", label, low, 100 * low / wire_rate, lost_at_wire);
+}
+
+// us from servo write `i` until the servo holds the duty value it was given, which is
+// where the next write started from, or the register for the last one
+unsigned long long TravelUs(unsigned int *from, int i, int count, unsigned char module){
+    unsigned int to = i + 1 < count ? from[i + 1] : DutyValue(module);
+    if(to == from[i]) return 0;
+    return (unsigned long long)((abs((int)to - (int)from[i]) * DUTY_STEP_US / SERVO_US_PER_MS + SERVO_SETTLE_MS) * 1000);
+}
+
+unsigned long long OnsetUs(int pick){
+    return pick_us[pick] + TravelUs(pick_from, pick, pick_count, 2);
+}
+
+void RecordServos(const char *commands){
+    pick_count = 0;
+    pitch_count = 0;
+    recording_picks = 1;
+    BenchSetup(commands);
+    recording_picks = 0;
+}
+
+// Onsets of a played song, when the pick reaches the string: they must land delay_ms apart,
+// with the pitch servo already holding the note
+void BenchOnsets(const char *label, const char *upload, unsigned int delay_ms){
+    BenchSetup(upload);
+    RecordServos("play start\r");
+
+    printf("%-40s %10s %10s %12s\n", label, "onset ms", "spacing", "pitch margin");
+    unsigned long long first = OnsetUs(0);
+    long worst = 0, margin_min = 0;
+    for(int i = 0; i < pick_count; i++){
+        unsigned long long onset = OnsetUs(i);
+        long spacing = i ? (long)((onset - OnsetUs(i - 1)) / 1000) : 0;
+        if(i && labs(spacing - (long)delay_ms) > worst) worst = labs(spacing - (long)delay_ms);
+        // the last pitch write before the onset is the note, it must have settled by then
+        int note = -1;
+        for(int j = 0; j < pitch_count && pitch_us[j] <= onset; j++) note = j;
+        long margin = note < 0 ? 0 : ((long long)onset - (long long)(pitch_us[note] + TravelUs(pitch_from, note, pitch_count, 1))) / 1000;
+        if(i == 0 || margin < margin_min) margin_min = margin;
+        printf("  note %-34d %10llu %10ld %12ld\n", i, (onset - first) / 1000, spacing, margin);
+    }
+    printf("%-40s %10ld %s\n", "max ms off the grid", worst, worst <= 1 ? "ok" : "FAIL");
+    printf("%-40s %10ld %s\n", "min ms pitch settled before onset", margin_min, margin_min >= 0 ? "ok" : "FAIL");
+}
+
+// First onset after an armed go, from two boards in different states: it must not depend on either
+void BenchArmedOnsets(const char *label, const char *setup_a, const char *setup_b){
+    const char *setups[2] = {setup_a, setup_b};
+    long first[2];
+    printf("%-40s %10s\n", label, "onset ms");
+    for(int i = 0; i < 2; i++){
+        BenchSetup(setups[i]);
+        Idle();
+        unsigned long long go_us = now_us + 2 * BYTE_US;
+        RecordServos("go\r");
+        first[i] = (long)((OnsetUs(0) - go_us) / 1000);
+        printf("  board %-34d %10ld\n", i, first[i]);
+    }
+    long apart = labs(first[0] - first[1]);
+    printf("%-40s %10ld %s\n", "max ms apart", apart, apart <= 1 ? "ok" : "FAIL");
+}
+
+#define COMMAND(label, str) BenchCommand(label, str, sizeof(str) - 1)
+
+int main(void){
+    SystemInitialize();
+
+    printf("# ISR benchmark, native build with mocked SFRs\n");
+    printf("# %lu Hz, %d baud, %lu us per byte on the wire\n", (unsigned long)_XTAL_FREQ, UART_BAUD_RATE, BYTE_US);
+    printf("# us columns count UART TX waits, __delay calls and the estimated Tcy of each call\n");
+    printf("# heard ms adds the pick lag of latency_table.h, %s\n", LATENCY_MEASURED ? "measured" : "a model estimate");
+    printf("# onsets move the servos at %.1f us/ms + %dms from the pulse widths written, not the table\n\n",
+           SERVO_US_PER_MS, SERVO_SETTLE_MS);
+
+    printf("%-40s %5s %7s %12s %12s %7s\n", "LowIsr command", "bytes", "entries", "total us", "max entry us", "tx");
+    COMMAND("reset", "reset\r");
+    COMMAND("status", "status\r");
+    COMMAND("pitch set pulse width us", "pitch set pulse width us 1200\r");
+    COMMAND("pitch set degree", "pitch set degree 30\r");
+    COMMAND("pitch set degree (out of range)", "pitch set degree 120\r");
+    COMMAND("pick set base degree", "pick set base degree 0\r");
+    COMMAND("pick set degree delta", "pick set degree delta 20\r");
+    COMMAND("pick", "pick\r");
+    COMMAND("play <count>", "play 4\r");
+    COMMAND("play <4 x n<note>,<delay>>", "play n48,250 n50,250 n52,250 n53,250\r");
+    COMMAND("play start (4 notes)", "play start\r");
+    // loop 2 { n48,250 n50,250 }, four notes like the ones above in 10 bytes
+    COMMAND("play code <count>", "play code 10\r");
+    COMMAND("play <10 bytes of code>", "play 820230FA0132FA018386\r");
+    COMMAND("play start (code, 4 notes)", "play start\r");
+    COMMAND("play <count>", "play 2\r");
+    COMMAND("play <2 x <us>,<delay>>", "play 1200,250 1300,250\r");
+    COMMAND("play arm", "play arm 100\r");
+    COMMAND("go (armed, 2 notes)", "go\r");
+    // the song is spent, this only waits out a lead-in delay() could not count to
+    COMMAND("play arm (5000ms)", "play arm 5000\r");
+    COMMAND("go (armed, lead-in only)", "go\r");
+    // from the previous live note, so the pitch servo makes a two semitone jump
+    BenchSetup("\x90\x3a");
+    COMMAND("live note on", "\x90\x3c");
+    COMMAND("live note on (not in table)", "\x90\x7f");
+    // the note byte after LIVE_NOTE_ON never came, the next command must still get through,
+    // also after gaps longer than one 524ms TMR1 wrap
+    BenchSetup("\x90");
+    IdleFor(200000);
+    COMMAND("status 200ms after lost note byte", "status\r");
+    BenchSetup("\x90");
+    IdleFor(530000);
+    COMMAND("status 530ms after lost note byte", "status\r");
+    BenchSetup("\x90");
+    IdleFor(1100000);
+    COMMAND("status 1100ms after lost note byte", "status\r");
+    // longer than the line buffer, what is left must not run as a command
+    COMMAND("play <overlong line>", "play n48,250 n48,250 n48,250 n48,250 n48,250 n48,250 n48,250 n48,250 n48,250 n48,250 n48,250 n48,250 n48,250 n48,250 n48,250 n48,250 n48,250\r");
+    COMMAND("unknown", "hello\r");
+
+    printf("\n%-40s %12s %12s %7s %10s\n", "Pick servo latency", "servo us", "done us", "tx", "heard ms");
+    BenchButton();
+    BenchSetup("\x90\x3a");
+    BenchLiveNote();
+
+    printf("\n");
+    BenchOnsets("Onsets, 4 notes 250ms apart", "reset\rplay 4\rplay n48,250 n53,250 n48,250 n53,250\r", 250);
+    printf("\n");
+    BenchArmedOnsets("Armed start, parts far apart",
+                     "reset\rpitch set pulse width us 1400\rplay 1\rplay n60,250\rplay arm 0\r",
+                     "reset\rpitch set pulse width us 900\rplay 1\rplay n46,250\rplay arm 0\r");
+
+    printf("\n%-40s %10s %7s %12s\n", "RX stream, no replies awaited", "max B/s", "wire", "lost at wire");
+    BenchStream("upload batches", "reset\rplay 64\r", "play n48,250 n50,250 n52,250 n53,250\r", 37, 16);
+    BenchStream("status polls", NULL, "status\r", 7, 16);
+    BenchStream("live note on", NULL, "\x90\x3c\x90\x3e", 4, 16);
+    // the way start.py streams, the board only sends its replies
+    BenchStream("upload batches, echo off", "reset\recho off\rplay 64\r", "play n48,250 n50,250 n52,250 n53,250\r", 37, 16);
+    BenchStream("status polls, echo off", "echo off\r", "status\r", 7, 16);
+    return 0;
+}
@@ -0,0 +1 @@
+#include "xc.h"
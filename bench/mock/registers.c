@@ -0,0 +1,86 @@
+// Storage for the mocked SFRs declared in xc.h
+#include "xc.h"
+
+MockBits TRISAbits;
+volatile unsigned char TRISA;
+MockBits TRISBbits;
+volatile unsigned char TRISB;
+MockBits TRISCbits;
+volatile unsigned char TRISC;
+MockBits TRISDbits;
+volatile unsigned char TRISD;
+MockBits TRISEbits;
+volatile unsigned char TRISE;
+MockBits LATAbits;
+volatile unsigned char LATA;
+MockBits LATBbits;
+volatile unsigned char LATB;
+MockBits LATCbits;
+volatile unsigned char LATC;
+MockBits LATDbits;
+volatile unsigned char LATD;
+MockBits LATEbits;
+volatile unsigned char LATE;
+MockBits PORTAbits;
+volatile unsigned char PORTA;
+MockBits PORTBbits;
+volatile unsigned char PORTB;
+MockBits PORTCbits;
+volatile unsigned char PORTC;
+MockBits PORTDbits;
+volatile unsigned char PORTD;
+MockBits PORTEbits;
+volatile unsigned char PORTE;
+MockBits ADCON0bits;
+volatile unsigned char ADCON0;
+MockBits ADCON1bits;
+volatile unsigned char ADCON1;
+MockBits ADCON2bits;
+volatile unsigned char ADCON2;
+MockBits PIE1bits;
+volatile unsigned char PIE1;
+MockBits PIE2bits;
+volatile unsigned char PIE2;
+MockBits PIR1bits;
+volatile unsigned char PIR1;
+MockBits PIR2bits;
+volatile unsigned char PIR2;
+MockBits IPR1bits;
+volatile unsigned char IPR1;
+MockBits IPR2bits;
+volatile unsigned char IPR2;
+MockBits INTCONbits;
+volatile unsigned char INTCON;
+MockBits INTCON2bits;
+volatile unsigned char INTCON2;
+MockBits INTCON3bits;
+volatile unsigned char INTCON3;
+MockBits RCONbits;
+volatile unsigned char RCON;
+MockBits CCP1CONbits;
+volatile unsigned char CCP1CON;
+MockBits CCP2CONbits;
+volatile unsigned char CCP2CON;
+MockBits T0CONbits;
+volatile unsigned char T0CON;
+MockBits T1CONbits;
+volatile unsigned char T1CON;
+MockBits T2CONbits;
+volatile unsigned char T2CON;
+MockBits T3CONbits;
+volatile unsigned char T3CON;
+MockBits RCSTAbits;
+volatile unsigned char RCSTA;
+volatile unsigned char TXSTA;
+MockBits BAUDCONbits;
+volatile unsigned char BAUDCON;
+MockBits EECON1bits;
+volatile unsigned char EECON1;
+volatile unsigned char PR2, TMR2, SPBRG, SPBRGH;
+volatile unsigned char ADRESH, ADRESL;
+volatile unsigned char TMR0L, TMR0H, TMR1L, TMR1H, TMR3L, TMR3H;
+volatile unsigned char EEADR, EEDATA, EECON2, WREG, STATUS;
+volatile unsigned char CCPR1H, CCPR2H;
+volatile unsigned int TMR0, TMR3, CCPR1, CCPR2;
+volatile unsigned char IRCF0, IRCF1, IRCF2;
+volatile unsigned char RCIF, TXIF, ADIF, TMR1IF, TMR2IF, CCP1IF, CCP2IF, TMR3IF, TMR0IF, INT0IF;
@@ -0,0 +1,337 @@
+/*
+ * Native stand-in for <xc.h> used by the ISR benchmark (see bench/isr_bench.c).
+ *
+ * Every SFR is a plain variable, and every "bits" view shares one struct with
+ * a byte per field, so firmware code compiles unchanged with gcc. Only the
+ * registers whose timing matters are hooked:
+ *   TXREG   a write first waits for the previous byte to leave the wire
+ *   TXSTA   TRMT reads 0 until the last byte written has left the wire
+ *   RCREG   a read pops the receive FIFO filled by the benchmark
+ *   CCPR1L, CCPR2L  writes are timestamped (servo command issued)
+ *   __delay_ms / __delay_us advance the virtual clock
+ */
+#ifndef MOCK_XC_H
+#define MOCK_XC_H
+
+typedef struct {
+    unsigned char ACQT;
+    unsigned char ADCS;
+    unsigned char ADFM;
+    unsigned char ADIE;
+    unsigned char ADIF;
+    unsigned char ADIP;
+    unsigned char ADON;
+    unsigned char BRG16;
+    unsigned char BRGH;
+    unsigned char CCP1IE;
+    unsigned char CCP1IF;
+    unsigned char CCP1IP;
+    unsigned char CCP1M;
+    unsigned char CCP2IE;
+    unsigned char CCP2IF;
+    unsigned char CCP2IP;
+    unsigned char CCP2M;
+    unsigned char CCP3M;
+    unsigned char CFGS;
+    unsigned char CHS;
+    unsigned char CREN;
+    unsigned char DC1B;
+    unsigned char DC2B;
+    unsigned char EEPGD;
+    unsigned char FERR;
+    unsigned char FREE;
+    unsigned char GIE;
+    unsigned char GIEH;
+    unsigned char GIEL;
+    unsigned char GO;
+    unsigned char GO_DONE;
+    unsigned char INT0IE;
+    unsigned char INT0IF;
+    unsigned char INT1IE;
+    unsigned char INT1IF;
+    unsigned char INT1IP;
+    unsigned char INT2IE;
+    unsigned char INT2IF;
+    unsigned char INT2IP;
+    unsigned char IPEN;
+    unsigned char LATA0;
+    unsigned char LATA1;
+    unsigned char LATA2;
+    unsigned char LATA3;
+    unsigned char LATA4;
+    unsigned char LATA5;
+    unsigned char LATA6;
+    unsigned char LATA7;
+    unsigned char LATB0;
+    unsigned char LATB1;
+    unsigned char LATB2;
+    unsigned char LATB3;
+    unsigned char LATB4;
+    unsigned char LATB5;
+    unsigned char LATB6;
+    unsigned char LATB7;
+    unsigned char LATC0;
+    unsigned char LATC1;
+    unsigned char LATC2;
+    unsigned char LATC3;
+    unsigned char LATC4;
+    unsigned char LATC5;
+    unsigned char LATC6;
+    unsigned char LATC7;
+    unsigned char LATD0;
+    unsigned char LATD1;
+    unsigned char LATD2;
+    unsigned char LATD3;
+    unsigned char LATD4;
+    unsigned char LATD5;
+    unsigned char LATD6;
+    unsigned char LATD7;
+    unsigned char LATE0;
+    unsigned char LATE1;
+    unsigned char LATE2;
+    unsigned char LATE3;
+    unsigned char LATE4;
+    unsigned char LATE5;
+    unsigned char LATE6;
+    unsigned char LATE7;
+    unsigned char OERR;
+    unsigned char PCFG;
+    unsigned char PEIE;
+    unsigned char PSA;
+    unsigned char RA0;
+    unsigned char RA1;
+    unsigned char RA2;
+    unsigned char RA3;
+    unsigned char RA4;
+    unsigned char RA5;
+    unsigned char RA6;
+    unsigned char RA7;
+    unsigned char RB0;
+    unsigned char RB1;
+    unsigned char RB2;
+    unsigned char RB3;
+    unsigned char RB4;
+    unsigned char RB5;
+    unsigned char RB6;
+    unsigned char RB7;
+    unsigned char RBIE;
+    unsigned char RBIF;
+    unsigned char RBIP;
+    unsigned char RC0;
+    unsigned char RC1;
+    unsigned char RC2;
+    unsigned char RC3;
+    unsigned char RC4;
+    unsigned char RC5;
+    unsigned char RC6;
+    unsigned char RC7;
+    unsigned char RCIE;
+    unsigned char RCIF;
+    unsigned char RCIP;
+    unsigned char RD;
+    unsigned char RD0;
+    unsigned char RD1;
+    unsigned char RD16;
+    unsigned char RD2;
+    unsigned char RD3;
+    unsigned char RD4;
+    unsigned char RD5;
+    unsigned char RD6;
+    unsigned char RD7;
+    unsigned char RE0;
+    unsigned char RE1;
+    unsigned char RE2;
+    unsigned char RE3;
+    unsigned char RE4;
+    unsigned char RE5;
+    unsigned char RE6;
+    unsigned char RE7;
+    unsigned char SPEN;
+    unsigned char SYNC;
+    unsigned char T08BIT;
+    unsigned char T0CS;
+    unsigned char T0PS;
+    unsigned char T1CKPS;
+    unsigned char T2CKPS;
+    unsigned char T2OUTPS;
+    unsigned char T3CCP1;
+    unsigned char T3CCP2;
+    unsigned char T3CKPS;
+    unsigned char TMR0IE;
+    unsigned char TMR0IF;
+    unsigned char TMR0IP;
+    unsigned char TMR0ON;
+    unsigned char TMR1CS;
+    unsigned char TMR1IE;
+    unsigned char TMR1IF;
+    unsigned char TMR1IP;
+    unsigned char TMR1ON;
+    unsigned char TMR2IE;
+    unsigned char TMR2IF;
+    unsigned char TMR2IP;
+    unsigned char TMR2ON;
+    unsigned char TMR3CS;
+    unsigned char TMR3IE;
+    unsigned char TMR3IF;
+    unsigned char TMR3IP;
+    unsigned char TMR3ON;
+    unsigned char TRISA0;
+    unsigned char TRISA1;
+    unsigned char TRISA2;
+    unsigned char TRISA3;
+    unsigned char TRISA4;
+    unsigned char TRISA5;
+    unsigned char TRISA6;
+    unsigned char TRISA7;
+    unsigned char TRISB0;
+    unsigned char TRISB1;
+    unsigned char TRISB2;
+    unsigned char TRISB3;
+    unsigned char TRISB4;
+    unsigned char TRISB5;
+    unsigned char TRISB6;
+    unsigned char TRISB7;
+    unsigned char TRISC0;
+    unsigned char TRISC1;
+    unsigned char TRISC2;
+    unsigned char TRISC3;
+    unsigned char TRISC4;
+    unsigned char TRISC5;
+    unsigned char TRISC6;
+    unsigned char TRISC7;
+    unsigned char TRISD0;
+    unsigned char TRISD1;
+    unsigned char TRISD2;
+    unsigned char TRISD3;
+    unsigned char TRISD4;
+    unsigned char TRISD5;
+    unsigned char TRISD6;
+    unsigned char TRISD7;
+    unsigned char TRISE0;
+    unsigned char TRISE1;
+    unsigned char TRISE2;
+    unsigned char TRISE3;
+    unsigned char TRISE4;
+    unsigned char TRISE5;
+    unsigned char TRISE6;
+    unsigned char TRISE7;
+    unsigned char TRMT;
+    unsigned char TXEN;
+    unsigned char TXIE;
+    unsigned char TXIF;
+    unsigned char TXIP;
+    unsigned char VCFG0;
+    unsigned char VCFG1;
+    unsigned char WR;
+    unsigned char WREN;
+} MockBits;
+
+extern MockBits TRISAbits;
+extern volatile unsigned char TRISA;
+extern MockBits TRISBbits;
+extern volatile unsigned char TRISB;
+extern MockBits TRISCbits;
+extern volatile unsigned char TRISC;
+extern MockBits TRISDbits;
+extern volatile unsigned char TRISD;
+extern MockBits TRISEbits;
+extern volatile unsigned char TRISE;
+extern MockBits LATAbits;
+extern volatile unsigned char LATA;
+extern MockBits LATBbits;
+extern volatile unsigned char LATB;
+extern MockBits LATCbits;
+extern volatile unsigned char LATC;
+extern MockBits LATDbits;
+extern volatile unsigned char LATD;
+extern MockBits LATEbits;
+extern volatile unsigned char LATE;
+extern MockBits PORTAbits;
+extern volatile unsigned char PORTA;
+extern MockBits PORTBbits;
+extern volatile unsigned char PORTB;
+extern MockBits PORTCbits;
+extern volatile unsigned char PORTC;
+extern MockBits PORTDbits;
+extern volatile unsigned char PORTD;
+extern MockBits PORTEbits;
+extern volatile unsigned char PORTE;
+extern MockBits ADCON0bits;
+extern volatile unsigned char ADCON0;
+extern MockBits ADCON1bits;
+extern volatile unsigned char ADCON1;
+extern MockBits ADCON2bits;
+extern volatile unsigned char ADCON2;
+extern MockBits PIE1bits;
+extern volatile unsigned char PIE1;
+extern MockBits PIE2bits;
+extern volatile unsigned char PIE2;
+extern MockBits PIR1bits;
+extern volatile unsigned char PIR1;
+extern MockBits PIR2bits;
+extern volatile unsigned char PIR2;
+extern MockBits IPR1bits;
+extern volatile unsigned char IPR1;
+extern MockBits IPR2bits;
+extern volatile unsigned char IPR2;
+extern MockBits INTCONbits;
+extern volatile unsigned char INTCON;
+extern MockBits INTCON2bits;
+extern volatile unsigned char INTCON2;
+extern MockBits INTCON3bits;
+extern volatile unsigned char INTCON3;
+extern MockBits RCONbits;
+extern volatile unsigned char RCON;
+extern MockBits CCP1CONbits;
+extern volatile unsigned char CCP1CON;
+extern MockBits CCP2CONbits;
+extern volatile unsigned char CCP2CON;
+extern MockBits T0CONbits;
+extern volatile unsigned char T0CON;
+extern MockBits T1CONbits;
+extern volatile unsigned char T1CON;
+extern MockBits T2CONbits;
+extern volatile unsigned char T2CON;
+extern MockBits T3CONbits;
+extern volatile unsigned char T3CON;
+extern MockBits RCSTAbits;
+extern volatile unsigned char RCSTA;
+extern volatile unsigned char TXSTA;
+extern MockBits BAUDCONbits;
+extern volatile unsigned char BAUDCON;
+extern MockBits EECON1bits;
+extern volatile unsigned char EECON1;
+
+extern volatile unsigned char PR2, TMR2, SPBRG, SPBRGH;
+extern volatile unsigned char ADRESH, ADRESL;
+extern volatile unsigned char TMR0L, TMR0H, TMR1L, TMR1H, TMR3L, TMR3H;
+extern volatile unsigned char EEADR, EEDATA, EECON2, WREG, STATUS;
+extern volatile unsigned char CCPR1H, CCPR2H;
+extern volatile unsigned int TMR0, TMR3, CCPR1, CCPR2;
+extern volatile unsigned char IRCF0, IRCF1, IRCF2;
+extern volatile unsigned char RCIF, TXIF, ADIF, TMR1IF, TMR2IF, CCP1IF, CCP2IF, TMR3IF, TMR0IF, INT0IF;
+
+// Timing hooks, implemented by the benchmark
+void MockWaitUs(unsigned long us);
+volatile unsigned char *MockTxRegister(void);
+MockBits *MockTxStatus(void);
+unsigned char MockRxRead(void);
+volatile unsigned char *MockCcpRegister(unsigned char module);
+volatile unsigned int *MockTimer1(void);
+
+#define TXREG (*MockTxRegister())
+#define TXSTAbits (*MockTxStatus())
+#define RCREG MockRxRead()
+#define CCPR1L (*MockCcpRegister(1))
+#define CCPR2L (*MockCcpRegister(2))
+#define TMR1 (*MockTimer1())
+
+#define __delay_ms(x) MockWaitUs((unsigned long)(x) * 1000UL)
+#define __delay_us(x) MockWaitUs((unsigned long)(x))
+#define __bit unsigned char
+#define __interrupt(x)
+#define NOP()
+#define di()
+#define ei()
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ * File:   song_check.c
+ *
+ * utils/song.c built natively: reads bytecode as hex from stdin and prints
+ * every event SongNext() returns, "<kind> <value> <delay_ms>" per line.
+ * song.py --check compares them with its own expand().
+ *
+ * Build and run with `make song-check`.
+ */
+
+#include <stdio.h>
+#include "../utils/song.h"
+
+int main(void){
+    unsigned int byte;
+    SongClear();
+    while(scanf("%2x", &byte) == 1){
+        if(!SongAppend(byte)) return 1;
+    }
+    SongRewind();
+    SongEvent event;
+    for(SongNext(&event); event.kind != SONG_DONE; SongNext(&event)){
+        printf("%d %u %u\n", event.kind, event.value, event.delay_ms);
+    }
+    return 0;
+}
@@ -0,0 +1,196 @@
+import os
+import re
+import sys
+
+import numpy as np
+
+NOTE_TABLE_HEADER = 'utils/note_table.h'
+CONFIG_HEADER = 'utils/config.h'
+# Timer2 prescaler PWMInitialize() picks above 1MHz
+PWM_PRESCALER = 16
+
+
+def note_to_freq(note: float):
+    return 440 * 2 ** ((note - 69) / 12)
+
+
+def freq_to_note(freq):
+    return 69 + 12 * np.log2(np.asarray(freq) / 440)
+
+
+def read_groups(data_csv: str = 'pwm_freq_data.csv'):
+    # Each sweep is a group of rising (pwm, freq) pairs, a new group starts when PWM decreases
+    lines = []
+    current_line = []
+    prev_pwm = float('inf')
+
+    with open(data_csv, 'r', encoding='utf-8') as f:
+        for line in f:
+            if not line.strip():
+                continue
+            pwm, freq = map(float, line.strip().split(','))
+
+            if pwm < prev_pwm and current_line:
+                lines.append(current_line)
+                current_line = []
+
+            current_line.append((pwm, freq))
+            prev_pwm = pwm
+
+    if current_line:
+        lines.append(current_line)
+    return lines
+
+
+def isotonic(x, y):
+    # Pool adjacent violators: least squares non-decreasing fit of y over sorted x
+    x, y = np.asarray(x, dtype=float), np.asarray(y, dtype=float)
+
+    # Repeated pulse widths start as one block holding all their readings, otherwise two
+    # blocks at the same x could both survive and give np.interp a vertical step
+    unique_x, group = np.unique(x, return_inverse=True)
+    sums = np.bincount(group, weights=y)
+    counts = np.bincount(group)
+
+    blocks = []     # [sum, count, first x, last x]
+    for xi, total, count in zip(unique_x, sums, counts):
+        blocks.append([total, count, xi, xi])
+        while len(blocks) > 1 and blocks[-2][0] / blocks[-2][1] >= blocks[-1][0] / blocks[-1][1]:
+            total, count, _, last = blocks.pop()
+            blocks[-1][0] += total
+            blocks[-1][1] += count
+            blocks[-1][3] = last
+
+    # Blocks cover disjoint x ranges, so one knot per block at its mid x rises strictly,
+    # and merging every tie above makes the block means rise strictly as well
+    knots_x = np.array([(first + last) / 2 for _, _, first, last in blocks])
+    knots_y = np.array([total / count for total, count, _, _ in blocks])
+    assert np.all(np.diff(knots_x) > 0) and np.all(np.diff(knots_y) > 0), "isotonic knots must rise strictly"
+    return knots_x, knots_y
+
+
+class PitchModel:
+    """
+    Monotonic pitch curve of the string against pitch servo pulse width,
+    fitted in the note (log frequency) domain over every measurement group.
+    """
+
+    def __init__(self, pwms, freqs):
+        self.knots_pwm, self.knots_note = isotonic(pwms, freq_to_note(freqs))
+        if len(self.knots_pwm) < 2:
+            raise ValueError("Need at least two distinct calibration points")
+
+    @classmethod
+    def from_csv(cls, data_csv: str = 'pwm_freq_data.csv'):
+        points = [point for line in read_groups(data_csv) for point in line]
+        return cls([pwm for pwm, _ in points], [freq for _, freq in points])
+
+    @classmethod
+    def from_table(cls, note_to_pwm: dict):
+        return cls(list(note_to_pwm.values()), [note_to_freq(note) for note in note_to_pwm])
+
+    @property
+    def note_range(self):
+        return self.knots_note[0], self.knots_note[-1]
+
+    def freq(self, pwm):
+        return note_to_freq(np.interp(pwm, self.knots_pwm, self.knots_note))
+
+    def pwm(self, note: float, cents: float = 0):
+        # Pulse width (us) for a MIDI note plus a cents offset, None outside the calibrated range
+        target = note + cents / 100
+        low, high = self.note_range
+        if not low - 1e-9 <= target <= high + 1e-9:
+            return None
+        return float(np.interp(target, self.knots_note, self.knots_pwm))
+
+    def pwm_of(self, note: int):
+        pwm = self.pwm(note)
+        return None if pwm is None else int(round(pwm))
+
+    def playable_notes(self):
+        low, high = self.note_range
+        return list(range(int(np.ceil(low - 1e-9)), int(np.floor(high + 1e-9)) + 1))
+
+
+def xtal_freq(config_h: str = CONFIG_HEADER):
+    with open(config_h, 'r', encoding='utf-8') as f:
+        return int(re.search(r'#define\s+_XTAL_FREQ\s+(\d+)', f.read()).group(1))
+
+
+def write_note_table(model: PitchModel, header: str = NOTE_TABLE_HEADER, source: str = '',
+                     xtal: int | None = None, prescaler: int = PWM_PRESCALER):
+    # CCPR1L:DC1B value = pulse width * Fosc / prescaler, same as PWMSetDutyCycle()
+    xtal = xtal or xtal_freq()
+    notes = model.playable_notes()
+    values = [int(round(model.pwm(note) * (xtal / 1000000) / prescaler)) for note in notes]
+
+    rows = []
+    for i in range(0, len(values), 8):
+        rows.append('    ' + ', '.join(f'{value:4d}' for value in values[i:i + 8]) + ',')
+
+    with open(header, 'w', encoding='utf-8') as f:
+        f.write(f"""// Generated by calibrate.py{' from ' + source if source else ''}, do not edit
+#ifndef NOTE_TABLE_H
+#define NOTE_TABLE_H
+
+#include "config.h"
+
+#if _XTAL_FREQ != {xtal}
+#error "note_table.h was generated for another oscillator, rerun calibrate.py"
+#endif
+
+#define NOTE_TABLE_FIRST {notes[0]}
+#define NOTE_TABLE_LAST {notes[-1]}
+#define NoteInTable(note) (NOTE_TABLE_FIRST <= (note) && (note) <= NOTE_TABLE_LAST)
+#define NoteToDutyValue(note) (note_table[(note) - NOTE_TABLE_FIRST])
+
+// CCPR1L:DC1B duty value of each MIDI note, Timer2 prescaler {prescaler}
+static const unsigned int note_table[] = {{
+{chr(10).join(rows)}
+}};
+
+#endif
+""")
+    return dict(zip(notes, values))
+
+
+def read_note_table(header: str = NOTE_TABLE_HEADER):
+    # {note: pulse width us} of the table the firmware plays from, the inverse of write_note_table()
+    with open(header, 'r', encoding='utf-8') as f:
+        text = f.read()
+    first = int(re.search(r'#define\s+NOTE_TABLE_FIRST\s+(\d+)', text).group(1))
+    xtal = int(re.search(r'_XTAL_FREQ\s*!=\s*(\d+)', text).group(1))
+    prescaler = re.search(r'Timer2 prescaler (\d+)', text)
+    prescaler = int(prescaler.group(1)) if prescaler else PWM_PRESCALER
+    values = re.search(r'note_table\[\]\s*=\s*\{([^}]*)\}', text).group(1)
+    values = [int(value) for value in re.findall(r'\d+', values)]
+    return {first + i: value * prescaler / (xtal / 1000000) for i, value in enumerate(values)}
+
+
+def load_pitch_model(note_to_pwm: dict, data_csv: str = 'pwm_freq_data.csv', header: str = NOTE_TABLE_HEADER):
+    # The board only plays the notes in note_table.h, so the host plans with that same table.
+    # Without one, prefer measured sweeps, then the hand tuned note table
+    if os.path.exists(header):
+        try:
+            return PitchModel.from_table(read_note_table(header))
+        except (AttributeError, ValueError):
+            print(f"\033[93m{header} is not a note table from calibrate.py, planning without it\033[0m")
+    if os.path.exists(data_csv) and os.path.getsize(data_csv) > 0:
+        try:
+            return PitchModel.from_csv(data_csv)
+        except ValueError:
+            pass
+    return PitchModel.from_table(note_to_pwm)
+
+
+if __name__ == "__main__":
+    # Usage: python calibrate.py [pwm_freq_data.csv], without data the NOTE_TO_PWM table is used
+    from start import NOTE_TO_PWM
+
+    if len(sys.argv) > 1:
+        model, source = PitchModel.from_csv(sys.argv[1]), sys.argv[1]
+    else:
+        model, source = PitchModel.from_table(NOTE_TO_PWM), 'NOTE_TO_PWM'
+    table = write_note_table(model, source=source)
+    print(f"Wrote {len(table)} notes ({min(table)}~{max(table)}) to {NOTE_TABLE_HEADER}")
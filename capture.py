@@ -0,0 +1,203 @@
+import struct
+import sys
+import threading
+import time
+from dataclasses import dataclass
+
+CAPTURE_MAGIC = b'UCAP'
+CAPTURE_VERSION = 1
+TX = b'T'
+RX = b'R'
+# Bytes in the same direction closer than this share one record
+MERGE_GAP_S = 0.02
+MAX_RECORD = 0xFFFF
+
+HEADER = struct.Struct('<4sBI')     # magic, version, baudrate
+RECORD = struct.Struct('<cIIH')     # direction, us since the previous record, us to its last byte, length
+
+
+@dataclass
+class Record:
+    direction: bytes
+    time: float     # seconds since the capture started
+    data: bytes
+    end: float = 0.0    # time of the last byte
+
+
+class CaptureWriter:
+    """
+    Appends timestamped TX/RX records to a capture file. Consecutive bytes in
+    one direction are merged, so a session costs a few bytes per exchange.
+    """
+
+    def __init__(self, path: str, baudrate: int):
+        self.file = open(path, 'wb')
+        self.file.write(HEADER.pack(CAPTURE_MAGIC, CAPTURE_VERSION, baudrate))
+        self.start = time.perf_counter()
+        self.current = None         # Record being merged into
+        self.last_byte = 0.0
+        self.last_written = 0.0
+        self._lock = threading.Lock()
+
+    def add(self, direction: bytes, data: bytes):
+        if not data:
+            return
+        with self._lock:
+            now = time.perf_counter() - self.start
+            current = self.current
+            if (current and current.direction == direction and now - self.last_byte < MERGE_GAP_S
+                    and len(current.data) + len(data) <= MAX_RECORD):
+                current.data += data
+                current.end = now
+            else:
+                self._flush()
+                self.current = Record(direction, now, bytes(data), now)
+            self.last_byte = now
+
+    def _flush(self):
+        if self.current is None:
+            return
+        delta_us = round((self.current.time - self.last_written) * 1e6)
+        duration_us = round((self.current.end - self.current.time) * 1e6)
+        self.file.write(RECORD.pack(self.current.direction, delta_us, duration_us, len(self.current.data)))
+        self.file.write(self.current.data)
+        # a session that dies without close() still leaves every finished record on disk
+        self.file.flush()
+        self.last_written = self.current.time
+        self.current = None
+
+    def close(self):
+        with self._lock:
+            self._flush()
+            self.file.close()
+
+
+class CapturePort:
+    # Drop-in for a serial.Serial that records everything written and read
+    def __init__(self, port, path: str):
+        self.port = port
+        self.capture = CaptureWriter(path, port.baudrate)
+
+    def write(self, data):
+        self.capture.add(TX, bytes(data))
+        return self.port.write(data)
+
+    def read(self, size=1):
+        data = self.port.read(size)
+        self.capture.add(RX, data)
+        return data
+
+    def close(self):
+        self.capture.close()
+        self.port.close()
+
+    def __getattr__(self, name):
+        return getattr(self.port, name)
+
+
+def load_capture(path: str):
+    with open(path, 'rb') as f:
+        magic, version, baudrate = HEADER.unpack(f.read(HEADER.size))
+        if magic != CAPTURE_MAGIC or version != CAPTURE_VERSION:
+            raise ValueError(f"{path} is not a version {CAPTURE_VERSION} capture")
+
+        records, now = [], 0.0
+        while header := f.read(RECORD.size):
+            direction, delta_us, duration_us, length = RECORD.unpack(header)
+            now += delta_us / 1e6
+            records.append(Record(direction, now, f.read(length), now + duration_us / 1e6))
+    return baudrate, records
+
+
+def exchanges(records):
+    # Each TX with the RX that followed it, until the next TX
+    result = []
+    for record in records:
+        if record.direction == TX:
+            result.append([record, b'', record.time])
+        elif result:
+            result[-1][1] += record.data
+            result[-1][2] = record.end
+    return result
+
+
+# Replies end on one of these, reading up to it keeps a reply of the wrong length from
+# shifting every exchange after it
+BOUNDARIES = (b'<end>', b'\n', b'\r')
+
+
+def read_expected(port, expected: bytes, deadline: float):
+    # Until the board sent as many boundaries as the capture has, byte counts only for
+    # answers without one such as live note acks
+    boundary = next((marker for marker in BOUNDARIES if expected.endswith(marker)), None)
+    received = b''
+    while time.perf_counter() < deadline:
+        if boundary and received.count(boundary) >= expected.count(boundary):
+            break
+        if not boundary and len(received) >= len(expected):
+            break
+        received += port.read(1)
+    return received
+
+
+def replay(path: str, port, max_speed=False, verbose=False):
+    """
+    Sends the TX side of a capture to `port` and checks the board answers with the
+    same bytes. At original speed each write keeps its capture timestamp, at max
+    speed it goes out as soon as the previous answer is complete.
+    Returns (exchanges, mismatches, session seconds).
+    """
+    _, records = load_capture(path)
+    session = exchanges(records)
+    mismatches = 0
+
+    first = session[0][0].time if session else 0.0
+    start = time.perf_counter()
+    for i, (sent, expected, answered) in enumerate(session):
+        if not max_speed:
+            time.sleep(max(0.0, start + sent.time - first - time.perf_counter()))
+        # whatever came after the last boundary belongs to no reply, don't let it start this one
+        stray = port.read(port.in_waiting) if port.in_waiting else b''
+        if stray:
+            mismatches += 1
+            print(f"\033[91m Before exchange {i}: unexpected {stray!r}\033[0m")
+        port.write(sent.data)
+
+        # allow twice the original answer time, the board may be slower than the capture
+        deadline = time.perf_counter() + 2 * (answered - sent.time) + 2
+        received = read_expected(port, expected, deadline)
+        if received != expected:
+            mismatches += 1
+            print(f"\033[91m Exchange {i} {sent.data!r}: expected {expected!r}, got {received!r}\033[0m")
+        elif verbose:
+            print(f"\033[2m Exchange {i} {sent.data!r}: {len(received)} bytes ok\033[0m")
+    elapsed = time.perf_counter() - start
+
+    original = session[-1][2] - first if session else 0.0
+    print(f"Replayed {len(session)} exchanges, {mismatches} mismatched, session {elapsed:.2f}s "
+          f"(captured {original:.2f}s)")
+    return len(session), mismatches, elapsed
+
+
+if __name__ == "__main__":
+    # Usage: python capture.py session.ucap [serial port | --sim] [--max-speed]
+    #        record one with python start.py --capture session.ucap
+    from start import open_serial
+
+    args = [arg for arg in sys.argv[1:] if not arg.startswith('--max')]
+    path = args[0]
+    target = args[1] if len(args) > 1 else '--sim'
+    board = None
+    if target == '--sim':
+        from simboard import SimBoard
+        board = SimBoard(baudrate=load_capture(path)[0])
+        target = board.port
+
+    port = open_serial(target)
+    try:
+        _, failed, _ = replay(path, port, max_speed='--max-speed' in sys.argv)
+    finally:
+        port.close()
+        if board:
+            board.close()
+    sys.exit(1 if failed else 0)
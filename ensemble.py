@@ -0,0 +1,168 @@
+import sys
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+import mido
+
+from melody import MS_PER_TICK, extract_melody, extract_notes
+
+# play arm takes an unsigned int on the board
+MAX_LEAD_IN_MS = 65535
+
+
+def song_parts(midi_file: mido.MidiFile):
+    # One part per track with notes, or per channel when everything sits in one track
+    parts = {}
+    for note in extract_notes(midi_file):
+        parts.setdefault(note.track, []).append(note)
+    if len(parts) > 1:
+        return [({track}, None, notes) for track, notes in parts.items()]
+
+    channels = {}
+    for i, track in enumerate(midi_file.tracks):
+        for message in track:
+            if message.type == 'note_on':
+                channels.setdefault(message.channel, i)
+    parts = []
+    for channel, track in channels.items():
+        notes = extract_notes(midi_file, {track}, {channel})
+        if notes:
+            parts.append(({track}, {channel}, notes))
+    return parts
+
+
+def assign_parts(parts, boards: int):
+    # Busiest parts first, one per board; boards left over double the busiest ones
+    parts = sorted(parts, key=lambda part: -len(part[2]))[:boards]
+    return [parts[i % len(parts)] for i in range(boards)] if parts else []
+
+
+def lead_in_ms(parts):
+    # Rest before each part's first note so all parts keep their place in the song
+    first = [min(note.start for note in notes) for _, _, notes in parts]
+    earliest = min(first, default=0)
+    return [int((start - earliest) * MS_PER_TICK) for start in first]
+
+
+def wait_for(port, marker: str):
+    response = ''
+    while marker not in response:
+        data = port.read(1)
+        if not data:
+            raise TimeoutError(f"{port.port}: no {marker} (got {response!r})")
+        response += data.decode('utf-8', errors='replace')
+    return response
+
+
+def upload_all(ports, songs, debug=False):
+    # Uploads run in parallel, so the total time is that of the longest song, not the sum
+    from start import upload_song
+
+    def upload(port, data):
+        begin = time.perf_counter()
+        upload_song(data, debug=debug, port=port)
+        return time.perf_counter() - begin
+
+    with ThreadPoolExecutor(max_workers=len(ports)) as pool:
+        return list(pool.map(upload, ports, songs))
+
+
+def synchronized_start(ports, lead_ins):
+    """
+    Arm every board, then write the line 'go' to all ports at once. Each board starts
+    its song a fixed LATENCY_START_LEAD_MS after go whatever its part, see play_midi().
+    Returns how far apart in ms the go writes left the host. That is all the host
+    can see, the onsets themselves are not measured.
+    """
+    from start import uart_send
+
+    if max(lead_ins, default=0) > MAX_LEAD_IN_MS:
+        raise ValueError(f"Lead-in of {max(lead_ins)}ms is over the board's {MAX_LEAD_IN_MS}ms")
+    for port, lead_in in zip(ports, lead_ins):
+        port.reset_input_buffer()
+        response = uart_send(f'play arm {lead_in}\r', port=port)
+        if '<armed>' not in response:
+            raise RuntimeError(f"{port.port} did not arm: {response!r}")
+
+    barrier = threading.Barrier(len(ports))
+    sent = [None] * len(ports)
+
+    def go(i, port):
+        barrier.wait()
+        sent[i] = time.perf_counter()
+        port.write(b'go\r')
+        port.flush()
+        wait_for(port, '<go>')
+
+    threads = [threading.Thread(target=go, args=(i, port)) for i, port in enumerate(ports)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    return (max(sent) - min(sent)) * 1000
+
+
+def wait_all_done(ports):
+    with ThreadPoolExecutor(max_workers=len(ports)) as pool:
+        list(pool.map(lambda port: wait_for(port, '<done>'), ports))
+
+
+def part_transpose(midi_file, parts):
+    # Planning each part alone could put the boards in different keys
+    from calibrate import load_pitch_model
+    from planner import shared_transpose
+    from start import NOTE_TO_PWM
+
+    pitch_model = load_pitch_model(NOTE_TO_PWM)
+    melodies = [extract_melody(midi_file, tracks=tracks, channels=channels)[0] for tracks, channels, _ in parts]
+    transpose = shared_transpose(melodies, pitch_model.pwm_of)
+    if transpose is None:
+        print("\033[93mNo transposition fits every part, playing in the written key\033[0m")
+        return 0
+    print(f"Shared transpose {transpose:+d}")
+    return transpose
+
+
+def play_ensemble(midi_file: mido.MidiFile, port_names, debug=False):
+    from start import open_serial, prepare_song
+
+    parts = assign_parts(song_parts(midi_file), len(port_names))
+    if not parts:
+        print("\033[91mNo notes to play\033[0m")
+        return None
+
+    ports = [open_serial(name) for name in port_names]
+    try:
+        transpose = part_transpose(midi_file, parts)
+        songs = [prepare_song(midi_file, tracks, channels, transpose) for tracks, channels, _ in parts]
+        upload_times = upload_all(ports, songs, debug=debug)
+        spread = synchronized_start(ports, lead_in_ms(parts))
+
+        print("\nBoard                 Notes  Upload(s)")
+        for name, data, upload_time in zip(port_names, songs, upload_times):
+            print(f"{name:<20} {len(data):>6} {upload_time:>10.2f}")
+        print(f"go written to every board within {spread:.2f}ms, onset skew not measured")
+
+        wait_all_done(ports)
+        return spread
+    finally:
+        for port in ports:
+            port.close()
+
+
+if __name__ == "__main__":
+    # Usage: python ensemble.py file.mid port [port ...]
+    #        python ensemble.py file.mid --sim N     to run against N simulated boards
+    from simboard import SimBoard
+
+    path, ports = sys.argv[1], sys.argv[2:]
+    boards = []
+    if ports and ports[0] == '--sim':
+        boards = [SimBoard(time_scale=0.01, name=f'sim{i}') for i in range(int(ports[1]))]
+        ports = [board.port for board in boards]
+
+    play_ensemble(mido.MidiFile(path), ports)
+    for board in boards:
+        board.close()
@@ -0,0 +1,243 @@
+import csv
+import re
+import sys
+import time
+
+import numpy as np
+
+from calibrate import isotonic
+from planner import SERVO_SETTLE_MS, SERVO_US_PER_MS
+
+LATENCY_TABLE_HEADER = 'utils/latency_table.h'
+LATENCY_CSV = 'latency.csv'
+# Pitch lag is tabulated per pulse width jump, rounded up to the next step
+JUMP_STEP_US = 50
+JUMP_MAX_US = 1000
+# Same values as main.c (reset) and ccp.h
+DEGREE_DELTA = 20
+MOTOR_SPAN_US = 2400 - 500
+
+# Measurement
+SAMPLE_RATE = 44100
+RECORD_SECONDS = 1.0
+PRE_ROLL_S = 0.1
+PITCH_HOP_S = 0.01
+PITCH_TOLERANCE_CENTS = 30
+MEASURE_CENTER_US = 1240
+MEASURE_JUMPS_US = (50, 100, 150, 200, 300, 400, 500)
+PICK_STROKES = 8
+
+
+def model_lag_ms(jump_us: float):
+    # Speed model from planner.py, used until the servos are measured
+    return jump_us / SERVO_US_PER_MS + SERVO_SETTLE_MS
+
+
+def default_latencies():
+    stroke_us = 2 * DEGREE_DELTA * MOTOR_SPAN_US / 180
+    jumps = np.arange(0, JUMP_MAX_US + 1, JUMP_STEP_US)
+    return {
+        'pick_rise': [(stroke_us, model_lag_ms(stroke_us))],
+        'pick_fall': [(stroke_us, model_lag_ms(stroke_us))],
+        'pitch_up': [(jump, model_lag_ms(jump)) for jump in jumps],
+        'pitch_down': [(jump, model_lag_ms(jump)) for jump in jumps],
+    }
+
+
+def read_latencies(path: str = LATENCY_CSV):
+    # kind,jump_us,lag_ms per line, kind is pick_rise, pick_fall, pitch_up or pitch_down
+    latencies = {}
+    with open(path, 'r', encoding='utf-8') as f:
+        for kind, jump, lag in csv.reader(f):
+            latencies.setdefault(kind, []).append((float(jump), float(lag)))
+    return latencies
+
+
+def write_latencies(latencies, path: str = LATENCY_CSV):
+    with open(path, 'w', encoding='utf-8', newline='') as f:
+        writer = csv.writer(f)
+        for kind, samples in latencies.items():
+            for jump, lag in samples:
+                writer.writerow([kind, round(jump), round(lag, 1)])
+
+
+def pitch_lag_table(samples):
+    # Non-decreasing fit of lag over jump size, read at every step of the table
+    jumps, lags = zip(*samples)
+    knots_x, knots_y = isotonic(jumps, lags)
+    steps = np.arange(0, JUMP_MAX_US + 1, JUMP_STEP_US)
+    if len(knots_x) < 2:
+        return [knots_y[0]] * len(steps)
+    return np.interp(steps, knots_x, knots_y)
+
+
+def write_latency_table(latencies, header: str = LATENCY_TABLE_HEADER, source: str = '', measured: bool = False):
+    def ms(value):
+        return int(min(255, max(0, np.ceil(value))))
+
+    pick_rise = ms(np.median([lag for _, lag in latencies['pick_rise']]))
+    pick_fall = ms(np.median([lag for _, lag in latencies['pick_fall']]))
+    up = [ms(lag) for lag in pitch_lag_table(latencies['pitch_up'])]
+    down = [ms(lag) for lag in pitch_lag_table(latencies['pitch_down'])]
+
+    def rows(values):
+        return '\n'.join('    ' + ', '.join(f'{value:3d}' for value in values[i:i + 11]) + ','
+                         for i in range(0, len(values), 11))
+
+    with open(header, 'w', encoding='utf-8') as f:
+        f.write(f"""// Generated by latency.py{' from ' + source if source else ''}, do not edit
+#ifndef LATENCY_TABLE_H
+#define LATENCY_TABLE_H
+
+// {'Measured on the board' if measured else 'Estimates from the servo speed model, not measured: run python latency.py measure'}
+#define LATENCY_MEASURED {int(measured)}
+
+// ms from the pick command until the string sounds, per stroke direction
+#define LATENCY_PICK_RISE_MS {pick_rise}
+#define LATENCY_PICK_FALL_MS {pick_fall}
+
+// lead of an armed start, the worst rest and note jumps or the pick, so every board in an
+// ensemble hears its first note the same time after go whatever its part and pitch position
+#define LATENCY_START_LEAD_MS {max(down[-1] + up[-1], pick_rise, pick_fall)}
+
+// ms from a pitch command until the servo settles, per direction and pulse width jump
+#define LATENCY_JUMP_STEP_US {JUMP_STEP_US}
+#define LATENCY_JUMP_STEPS {len(up)}
+#define LatencyJumpIndex(jump_us) ((jump_us) >= LATENCY_JUMP_STEP_US * (LATENCY_JUMP_STEPS - 1) ? \\
+    LATENCY_JUMP_STEPS - 1 : ((jump_us) + LATENCY_JUMP_STEP_US - 1) / LATENCY_JUMP_STEP_US)
+#define LatencyPitchUpMs(jump_us) (latency_pitch_up_ms[LatencyJumpIndex(jump_us)])
+#define LatencyPitchDownMs(jump_us) (latency_pitch_down_ms[LatencyJumpIndex(jump_us)])
+
+static const unsigned char latency_pitch_up_ms[] = {{
+{rows(up)}
+}};
+
+static const unsigned char latency_pitch_down_ms[] = {{
+{rows(down)}
+}};
+
+#endif
+""")
+    return pick_rise, pick_fall, up, down
+
+
+def read_latency_table(header: str = LATENCY_TABLE_HEADER):
+    # The pick lags the firmware was built with, and whether they were measured
+    with open(header, 'r', encoding='utf-8') as f:
+        defines = dict(re.findall(r'#define (LATENCY_\w+) (\d+)', f.read()))
+    return (int(defines['LATENCY_PICK_RISE_MS']), int(defines['LATENCY_PICK_FALL_MS']),
+            defines.get('LATENCY_MEASURED') == '1')
+
+
+def onset_time(samples, rate: int):
+    # First sample whose envelope clears the pre-roll noise floor by a wide margin
+    envelope = np.abs(samples)
+    floor = envelope[:int(PRE_ROLL_S * rate * 0.8)].max() if len(envelope) else 0
+    above = np.nonzero(envelope > max(4 * floor, 0.02 * envelope.max()))[0]
+    return above[0] / rate if len(above) else None
+
+
+def pitch_track(samples, rate: int):
+    # (time, frequency) every PITCH_HOP_S, yin() skips its attack window so start each frame before it
+    from autotune import ATTACK_SKIP_S, FRAME_SIZE, yin
+
+    skip = int(ATTACK_SKIP_S * rate)
+    hop = int(PITCH_HOP_S * rate)
+    track = []
+    for start in range(0, len(samples) - FRAME_SIZE - skip, hop):
+        freq = yin(samples[start:start + skip + FRAME_SIZE], rate)
+        track.append(((start + skip + FRAME_SIZE / 2) / rate, freq))
+    return track
+
+
+def settle_time(track, after: float):
+    # First time after `after` from which the pitch stays within tolerance of where it ends
+    voiced = [(t, f) for t, f in track if f]
+    if len(voiced) < 3:
+        return None
+    final = np.median([f for _, f in voiced[-3:]])
+    settled = None
+    for t, f in voiced:
+        if t < after:
+            continue
+        if abs(1200 * np.log2(f / final)) <= PITCH_TOLERANCE_CENTS:
+            settled = settled if settled is not None else t
+        else:
+            settled = None
+    return settled
+
+
+def timed_command(uart_send, command: str, byte_s: float, record_start: float):
+    # Firmware acts on the '\r', which lands len(command) byte times after the write.
+    # Its echo is only queued, see UartSendChar(), the command runs right away
+    sent = time.perf_counter()
+    response = uart_send(command)
+    return sent + len(command) * byte_s - record_start, response
+
+
+def measure(uart_send, baudrate: int = 1200):
+    """
+    Records the string through the default input while the firmware picks and
+    moves the pitch servo, and returns the lags per kind as read_latencies() does.
+    """
+    import sounddevice
+
+    byte_s = 10 / baudrate
+    latencies = {'pick_rise': [], 'pick_fall': [], 'pitch_up': [], 'pitch_down': []}
+
+    # Pick: the onset after each command, direction from the reported degree
+    previous = None
+    for _ in range(PICK_STROKES):
+        recording = sounddevice.rec(int(RECORD_SECONDS * SAMPLE_RATE), samplerate=SAMPLE_RATE, channels=1)
+        start = time.perf_counter()
+        time.sleep(PRE_ROLL_S)
+        command_at, response = timed_command(uart_send, 'pick\r', byte_s, start)
+        sounddevice.wait()
+        degree = int(response.split('Motor degree: ')[1].split()[0]) if 'Motor degree: ' in response else None
+        onset = onset_time(recording[:, 0], SAMPLE_RATE)
+        if previous is not None and degree is not None and onset is not None:
+            kind = 'pick_rise' if degree > previous else 'pick_fall'
+            latencies[kind].append((2 * DEGREE_DELTA * MOTOR_SPAN_US / 180, (onset - command_at) * 1000))
+        previous = degree
+        time.sleep(0.5)
+
+    # Pitch: let the string ring, jump, and time until the pitch holds at the new note
+    for jump in MEASURE_JUMPS_US:
+        low, high = MEASURE_CENTER_US - jump // 2, MEASURE_CENTER_US + jump // 2
+        for kind, begin, end in (('pitch_up', low, high), ('pitch_down', high, low)):
+            uart_send(f'pitch set pulse width us {begin}\r')
+            time.sleep(0.5)
+            recording = sounddevice.rec(int(RECORD_SECONDS * SAMPLE_RATE), samplerate=SAMPLE_RATE, channels=1)
+            start = time.perf_counter()
+            uart_send('pick\r')
+            command_at, _ = timed_command(uart_send, f'pitch set pulse width us {end}\r', byte_s, start)
+            sounddevice.wait()
+            settled = settle_time(pitch_track(recording[:, 0].astype(np.float64), SAMPLE_RATE), command_at)
+            if settled is not None:
+                latencies[kind].append((jump, (settled - command_at) * 1000))
+
+    # Anything that could not be measured keeps the model
+    defaults = default_latencies()
+    return {kind: samples or defaults[kind] for kind, samples in latencies.items()}
+
+
+if __name__ == "__main__":
+    # Usage: python latency.py                 table from the servo speed model
+    #        python latency.py latency.csv     table from measurements
+    #        python latency.py measure         measure on the board, save latency.csv and the table
+    if len(sys.argv) > 1 and sys.argv[1] == 'measure':
+        from start import SERIAL_PORT, ser, uart_send
+
+        ser.port = SERIAL_PORT
+        ser.open()
+        latencies, source = measure(uart_send, ser.baudrate), LATENCY_CSV
+        write_latencies(latencies)
+    elif len(sys.argv) > 1:
+        latencies, source = read_latencies(sys.argv[1]), sys.argv[1]
+    else:
+        latencies, source = default_latencies(), 'the servo speed model'
+
+    rise, fall, up, down = write_latency_table(latencies, source=source, measured=len(sys.argv) > 1)
+    print(f"Wrote {LATENCY_TABLE_HEADER}: pick rise {rise}ms fall {fall}ms, "
+          f"pitch up {up[0]}~{up[-1]}ms, down {down[0]}~{down[-1]}ms"
+          f"{'' if len(sys.argv) > 1 else ', model estimates until measured'}")
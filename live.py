@@ -0,0 +1,128 @@
+import sys
+import threading
+import time
+from collections import deque
+
+import mido
+
+from calibrate import load_pitch_model
+from latency import read_latency_table
+from melody import clamp_note
+
+# Same values as main.c
+LIVE_NOTE_ON = 0x90
+LIVE_ACK_PLAYED = 0x80
+LIVE_ACK_REJECTED = 0x81
+LATENCY_BUDGET_MS = 30
+
+
+class LiveBridge:
+    """
+    Forwards note_on events to the board as two byte live events and times
+    each one until the board acknowledges the pick.
+    """
+
+    def __init__(self, port, playable, pick_lag_ms: float = 0.0, pick_lag_measured: bool = False):
+        self.port = port
+        # the ack goes out with the pick command, the string sounds this much later
+        self.pick_lag_ms = pick_lag_ms
+        self.pick_lag_measured = pick_lag_measured
+        self.playable = sorted(playable)
+        self.byte_ms = 10 / port.baudrate * 1000
+        self.sent = deque()         # event timestamps waiting for an ack
+        self.latencies = []
+        self.rejected = 0
+        self._lock = threading.Lock()
+        self._running = True
+        self._reader = threading.Thread(target=self._read_acks, daemon=True)
+        self._reader.start()
+
+    def _read_acks(self):
+        while self._running:
+            data = self.port.read(1)
+            if not data or data[0] not in (LIVE_ACK_PLAYED, LIVE_ACK_REJECTED):
+                continue
+            now = time.perf_counter()
+            with self._lock:
+                if not self.sent:
+                    continue
+                event_time = self.sent.popleft()
+            if data[0] == LIVE_ACK_REJECTED:
+                self.rejected += 1
+                continue
+            # The ack itself took one byte time on the wire after the pick
+            self.latencies.append((now - event_time) * 1000 - self.byte_ms)
+
+    def note_on(self, note: int, event_time: float | None = None):
+        note = clamp_note(note, self.playable)
+        with self._lock:
+            self.sent.append(event_time or time.perf_counter())
+        self.port.write(bytes([LIVE_NOTE_ON, note]))
+
+    def close(self, timeout: float = 1.0):
+        deadline = time.perf_counter() + timeout
+        while self.sent and time.perf_counter() < deadline:
+            time.sleep(0.01)
+        self._running = False
+        # the reader wakes up at the latest when its read times out
+        self._reader.join(max(deadline - time.perf_counter(), 0) + (self.port.timeout or 0))
+
+    def report(self):
+        if not self.latencies:
+            return "No notes acknowledged"
+        ordered = sorted(self.latencies)
+        p95 = ordered[min(len(ordered) - 1, int(len(ordered) * 0.95))]
+        mean = sum(ordered) / len(ordered)
+        wire_ms = 2 * self.byte_ms
+        lag = 'measured' if self.pick_lag_measured else 'model estimate, see latency.py'
+        # the ack is timed on the wire, the onset only adds the pick lag from latency_table.h
+        return (f"{len(ordered)} notes, {self.rejected} rejected\n"
+                f"Ack latency mean {mean:.1f}ms, p95 {p95:.1f}ms, max {ordered[-1]:.1f}ms "
+                f"(event on the wire {wire_ms:.1f}ms at {self.port.baudrate} baud, budget {LATENCY_BUDGET_MS}ms)\n"
+                f"Pick onset latency mean {mean + self.pick_lag_ms:.1f}ms, p95 {p95 + self.pick_lag_ms:.1f}ms, "
+                f"max {ordered[-1] + self.pick_lag_ms:.1f}ms (ack plus {self.pick_lag_ms:.0f}ms pick lag, {lag})")
+
+
+def midi_messages(source: str):
+    # A .mid file is replayed in real time as a stand-in for a live input port
+    if source.endswith('.mid'):
+        yield from mido.MidiFile(source).play()
+    else:
+        with mido.open_input(source) as port:
+            yield from port
+
+
+def run_live(source: str, port, debug=False):
+    from start import NOTE_TO_PWM
+
+    # strokes alternate, so half of them rise and half fall
+    rise, fall, measured = read_latency_table()
+    bridge = LiveBridge(port, load_pitch_model(NOTE_TO_PWM).playable_notes(), (rise + fall) / 2, measured)
+    try:
+        for message in midi_messages(source):
+            if message.type == 'note_on' and message.velocity > 0:
+                bridge.note_on(message.note)
+                if debug:
+                    print(f"\033[2m Live note {message.note}\033[0m")
+    except KeyboardInterrupt:
+        pass
+    bridge.close()
+    print(bridge.report())
+    return bridge
+
+
+if __name__ == "__main__":
+    # Usage: python live.py <file.mid | ALSA port name> [serial port | --sim]
+    from start import open_serial
+
+    source = sys.argv[1]
+    target = sys.argv[2] if len(sys.argv) > 2 else '--sim'
+    board = None
+    if target == '--sim':
+        from simboard import SimBoard
+        board = SimBoard(baudrate=1200)
+        target = board.port
+
+    run_live(source, open_serial(target))
+    if board:
+        board.close()
@@ -14,35 +14,53 @@
 #include "utils/uart.h"
 #include "utils/config.h"
 #include "utils/timer.h"
+#include "utils/servo.h"
+#include "utils/note_table.h"
+#include "utils/latency_table.h"
+#include "utils/song.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #define MOTOR_PERIOD_MS 20
-#define BUFFER_SIZE 64
-
-typedef struct {
-    unsigned int pwm_values[BUFFER_SIZE];
-    unsigned int delays[BUFFER_SIZE];
-    unsigned int count;
-    unsigned int current_idx;
-} NoteBuffer;
-
-NoteBuffer buffer1 = {0};
+#define PITCH_REST_US 900
 
+// Live mode: LIVE_NOTE_ON followed by a MIDI note byte plays it right away
+#define LIVE_NOTE_ON 0x90
+#define LIVE_ACK_PLAYED 0x80
+#define LIVE_ACK_REJECTED 0x81
+// a note byte later than this, or a '\r', means it was lost and the event is dropped
+#define LIVE_NOTE_TIMEOUT_MS 100
 __bit is_playing = 0;
+__bit is_armed = 0;
+__bit live_note_pending = 0;
+unsigned long live_note_at = 0;
 __bit pick_state = 0;
+// set by the button in HighIsr, main() picks and logs outside the interrupt
+volatile __bit button_pressed = 0;
 int degree_delta = 0;
 int base_degree = 0;
 unsigned int pending_notes = 0;
+unsigned int pending_code = 0;
+unsigned int arm_delay_ms = 0;
+
+#if SERVO_SETTLE_FEEDBACK
+unsigned int feedback_duty_neg = 0;
+unsigned int feedback_duty_pos = 0;
+long settle_saved_ms = 0;
+#endif
 
 void reset(){
-    buffer1.count = 0;
-    buffer1.current_idx = 0;
+    SongClear();
 
     is_playing = 0;
+    is_armed = 0;
+    arm_delay_ms = 0;
+    live_note_pending = 0;
     degree_delta = 20;
     base_degree = 0;
     pending_notes = 0;
+    pending_code = 0;
 }
 
 void SystemInitialize(void){
@@ -54,6 +72,7 @@ void SystemInitialize(void){
         .timer2 = INTERRUPT_NONE,
         .uart_tx = INTERRUPT_NONE,
         .uart_rx = INTERRUPT_LOW,
+        .servo = INTERRUPT_HIGH,
     };
     ComponentConfig component_config = {
         .prescaler1 = 8,
@@ -63,34 +82,60 @@ void SystemInitialize(void){
         .pwm_period_ms = MOTOR_PERIOD_MS,
     };
 
+    SystemComponents components = COMPONENT_LED | COMPONENT_UART | COMPONENT_PWM | COMPONENT_BUTTON | COMPONENT_TIMER1;
+#if SERVO_SETTLE_FEEDBACK
+    // play_midi() runs inside LowIsr, the ADC must be able to interrupt it
+    int_config.adc = INTERRUPT_HIGH;
+    components |= COMPONENT_ADC;
+#endif
+#if SERVO_CHANNEL_MASK
+    components |= COMPONENT_SERVO;
+#endif
+
     OscillatorInitialize();
-    ComponentInitialize(COMPONENT_LED | COMPONENT_UART | COMPONENT_PWM | COMPONENT_BUTTON | COMPONENT_TIMER1,
-                        &int_config, component_config);
+    ComponentInitialize(components, &int_config, component_config);
+#if SERVO_SETTLE_FEEDBACK
+    feedback_duty_neg = PWMDutyValueFromUs(MOTOR_NEG_90_DEG_US);
+    feedback_duty_pos = PWMDutyValueFromUs(MOTOR_POS_90_DEG_US);
+#endif
     PWMSetDutyCycle(1120);
     Motor2RotateDegree(0);
 }
 
-void rotate_pick_motor(){
+int pick_motor(){
+    // swing the pick to the other side, returns the new degree
+    int next_degree;
     if(pick_state){
-        int next_degree = base_degree + degree_delta;
+        next_degree = base_degree + degree_delta;
         if(next_degree > 90){
             next_degree = 90;
         }
-        Motor2RotateDegree(next_degree);
-        UartSendString("Motor degree: ");
-        UartSendInt(next_degree);
-        UartSendString("\n\r");
     }else{
-        int next_degree = base_degree - degree_delta;
+        next_degree = base_degree - degree_delta;
         if(next_degree < -90){
             next_degree = -90;
         }
-        Motor2RotateDegree(next_degree);
-        UartSendString("Motor degree: ");
-        UartSendInt(next_degree);
-        UartSendString("\n\r");
     }
+    Motor2RotateDegree(next_degree);
     pick_state = !pick_state;
+    return next_degree;
+}
+
+#if SERVO_CHANNEL_MASK
+unsigned char servo_channel_ok(int channel){
+    // a channel outside the mask has no pin driven, and past SERVO_CHANNELS no slot at all
+    return 0 <= channel && channel < SERVO_CHANNELS && ((SERVO_CHANNEL_MASK >> channel) & 0x01);
+}
+#endif
+
+void log_motor_degree(int degree){
+    UartSendString("Motor degree: ");
+    UartSendInt(degree);
+    UartSendString("\n\r");
+}
+
+void rotate_pick_motor(){
+    log_motor_degree(pick_motor());
 }
 
 void delay(unsigned int ms){
@@ -132,82 +177,323 @@ void delay(unsigned int ms){
     }
 }
 
+#if SERVO_SETTLE_FEEDBACK
+int expected_position(unsigned int duty_value){
+    long span = (long)SERVO_FEEDBACK_ADC_POS_90 - SERVO_FEEDBACK_ADC_NEG_90;
+    return SERVO_FEEDBACK_ADC_NEG_90 + span * ((long)duty_value - feedback_duty_neg) / (feedback_duty_pos - feedback_duty_neg);
+}
+
+unsigned int wait_pitch_settle(unsigned int duty_value, unsigned int min_ms, unsigned int timeout_ms){
+    // Sample AN0 every 1ms until the pitch servo reads back at duty_value, returns the ms waited
+    int target = expected_position(duty_value);
+    unsigned char in_range = 0;
+    unsigned int waited = 0;
+    while(waited < timeout_ms){
+        AdcStartConversion();
+        __delay_ms(1);
+        waited++;
+        if(AdcResultReady()){
+            int diff = (int)AdcGetResult() - target;
+            if(-SERVO_SETTLE_TOLERANCE <= diff && diff <= SERVO_SETTLE_TOLERANCE){
+                in_range++;
+            } else {
+                in_range = 0;
+            }
+        }
+        if(waited >= min_ms && in_range >= SERVO_SETTLE_SAMPLES) break;
+    }
+    return waited;
+}
+#endif
+
+void wait_until(unsigned long ms){
+    // unlike delay() this has no 4095ms limit
+    while((long)(ms - Timer1GetMillis()) > 0){
+        UartTxPoll();
+        __delay_ms(1);
+    }
+}
+
+#if !SERVO_SETTLE_FEEDBACK
+unsigned int pitch_lag_ms(unsigned int from_us, unsigned int to_us){
+    // predicted ms until the pitch servo settles, see latency_table.h
+    if(to_us >= from_us) return LatencyPitchUpMs(to_us - from_us);
+    return LatencyPitchDownMs(from_us - to_us);
+}
+#endif
+
+unsigned int song_duty_value(SongEvent *event){
+    // 0 for rests, a note missing from note_table.h rests as well
+    if(event->kind == SONG_NOTE && NoteInTable(event->value)) return NoteToDutyValue(event->value);
+    if(event->kind == SONG_PULSE) return PWMDutyValueFromUs(event->value);
+    return 0;
+}
 
-void play_midi(){
-    for(int i = 0; i < buffer1.count; i++){
-        UartSendString("Playing note: ");
-        UartSendInt(buffer1.pwm_values[i]);
-        UartSendString(", delay: ");
-        UartSendInt(buffer1.delays[i]);
-        UartSendString("\n\r");
-        UartSendString("<end>");
+void play_midi(unsigned int start_lead_ms){
+    // start_lead_ms 0 plays as soon as the first note can sound, an armed start passes
+    // LATENCY_START_LEAD_MS so the song begins that long after go on every board alike
+    // servo timing matters more than input, make the host wait. Nothing is logged per note,
+    // ~36 bytes at 1200 baud would take 300ms
+    UartRtsHold();
+    SongEvent event;
+    SongRewind();
+#if SERVO_SETTLE_FEEDBACK
+    unsigned long first_onset = Timer1GetMillis() + start_lead_ms;
+    for(SongNext(&event); event.kind != SONG_DONE; SongNext(&event)){
+        unsigned int duty_value = song_duty_value(&event);
+        if(!duty_value){
+            first_onset += event.delay_ms;
+            delay(event.delay_ms);
+            continue;
+        }
 
-        PWMSetDutyCycle(900);
-        __delay_ms(75);
-        PWMSetDutyCycle(buffer1.pwm_values[i]);
-        __delay_ms(5);
+        // pick as soon as the servo is in place, the fixed waits below become timeouts
+        PWMSetDutyCycle(PITCH_REST_US);
+        unsigned int settle_ms = wait_pitch_settle(PWMDutyValueFromUs(PITCH_REST_US), 0, 75);
+        PWMSetDutyValue(duty_value);
+        settle_ms += wait_pitch_settle(duty_value, 5, SERVO_SETTLE_TIMEOUT_MS);
+        if(start_lead_ms){
+            // rests before the first note have already gone by in delay()
+            wait_until(first_onset - (pick_state ? LATENCY_PICK_RISE_MS : LATENCY_PICK_FALL_MS));
+            start_lead_ms = 0;
+        }
         rotate_pick_motor();
-        if(buffer1.delays[i] >= 80) delay(buffer1.delays[i] - 80);
+        // against the fixed 75ms + 5ms the pitch servo was given before feedback
+        settle_saved_ms += 80 - (long)settle_ms;
+        if(event.delay_ms >= settle_ms) delay(event.delay_ms - settle_ms);
     }
-    buffer1.count = 0;
-    buffer1.current_idx = 0;
+#else
+    // Notes sound on the grid of delays: every command goes out early by its
+    // predicted lag, so onset is when the string is heard, not when it is told.
+    unsigned long onset = Timer1GetMillis() + start_lead_ms;
+    unsigned char started = start_lead_ms != 0;
+    for(SongNext(&event); event.kind != SONG_DONE; SongNext(&event)){
+        unsigned int duty_value = song_duty_value(&event);
+        if(!duty_value){
+            if(!started) onset = Timer1GetMillis();
+            started = 1;
+            onset += event.delay_ms;
+            continue;
+        }
+        unsigned int note_us = PWMDutyValueToUs(duty_value);
+        unsigned int note_lead = pitch_lag_ms(PITCH_REST_US, note_us);
+        unsigned int rest_lead = note_lead + pitch_lag_ms((unsigned int)PWMGetDutyCycle(), PITCH_REST_US);
+        unsigned int pick_lead = pick_state ? LATENCY_PICK_RISE_MS : LATENCY_PICK_FALL_MS;
+        if(!started){
+            onset = Timer1GetMillis() + (rest_lead > pick_lead ? rest_lead : pick_lead);
+            started = 1;
+        }
 
+        // rest comes before the note, the pick may fall anywhere around them
+        unsigned char picked = 0;
+        if(pick_lead >= rest_lead){
+            wait_until(onset - pick_lead);
+            pick_motor();
+            picked = 1;
+        }
+        wait_until(onset - rest_lead);
+        PWMSetDutyCycle(PITCH_REST_US);
+        if(!picked && pick_lead >= note_lead){
+            wait_until(onset - pick_lead);
+            pick_motor();
+            picked = 1;
+        }
+        wait_until(onset - note_lead);
+        PWMSetDutyValue(duty_value);
+        if(!picked){
+            wait_until(onset - pick_lead);
+            pick_motor();
+        }
+        onset += event.delay_ms;
+    }
+    wait_until(onset);
+#endif
+    SongClear();
+}
+
+void play_live_note(unsigned char note){
+    // No logging here, every byte sent at this baud rate adds to the note latency
+    if(!NoteInTable(note)){
+        UartSendChar(LIVE_ACK_REJECTED);
+        return;
+    }
+    unsigned int duty_value = NoteToDutyValue(note);
+#if SERVO_SETTLE_FEEDBACK
+    PWMSetDutyValue(duty_value);
+    wait_pitch_settle(duty_value, 1, SERVO_SETTLE_TIMEOUT_MS);
+#else
+    // start the pick early by its own lag, so both land together
+    unsigned int pitch_ms = pitch_lag_ms((unsigned int)PWMGetDutyCycle(), PWMDutyValueToUs(duty_value));
+    unsigned int pick_ms = pick_state ? LATENCY_PICK_RISE_MS : LATENCY_PICK_FALL_MS;
+    PWMSetDutyValue(duty_value);
+    if(pitch_ms > pick_ms) delay(pitch_ms - pick_ms);
+#endif
+    pick_motor();
+    UartSendChar(LIVE_ACK_PLAYED);
 }
 
 void parse_to_buffer(char *str){
     char *token = strtok(str, " ");
-    while(token != NULL && buffer1.count < BUFFER_SIZE && pending_notes > 0){
+    while(token != NULL && pending_notes > 0){
         char tmp[UART_BUFFER_SIZE];
         strcpy(tmp, token);
 
-        int pwm_val, delay_val;
-        if(!(sscanf(tmp, "%d,%d", &pwm_val, &delay_val) == 2)){
+        // "n<note>,<delay>" looks the note up in note_table.h, "<pulse width us>,<delay>" is used as is
+        int note_val, pwm_val, delay_val;
+        if(sscanf(tmp, "n%d,%d", &note_val, &delay_val) == 2){
+            if(!NoteInTable(note_val) || !SongAppendNote(note_val, delay_val)){
+                return;
+            }
+        } else if(sscanf(tmp, "%d,%d", &pwm_val, &delay_val) == 2){
+            if(!SongAppendPulse(pwm_val, delay_val)){
+                return;
+            }
+        } else {
             return;
         }
-        buffer1.pwm_values[buffer1.count] = pwm_val;
-        buffer1.delays[buffer1.count] = delay_val;
-        buffer1.count++;
         pending_notes--;
 
         token = strtok(NULL, " ");
     }
 }
 
+int hex_value(char c){
+    if('0' <= c && c <= '9') return c - '0';
+    if('A' <= c && c <= 'F') return c - 'A' + 10;
+    if('a' <= c && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+void parse_code(char *str){
+    // song.py sends the bytecode as two hex digits per byte
+    while(pending_code > 0 && hex_value(str[0]) >= 0 && hex_value(str[1]) >= 0){
+        if(!SongAppend((hex_value(str[0]) << 4) | hex_value(str[1]))){
+            return;
+        }
+        pending_code--;
+        str += 2;
+    }
+}
+
+void service_button(void){
+    // HighIsr only flags the press, the soft-float degree math would hold up the servo edges.
+    // LowIsr picks during songs, keep it out while pick_state and CCPR2 change
+    if(!button_pressed) return;
+    button_pressed = 0;
+    INTCONbits.GIEL = 0;
+    int degree = pick_motor();
+    INTCONbits.GIEL = 1;
+    log_motor_degree(degree);
+}
+
 void main(void) {
     SystemInitialize();
     while(1){
+        service_button();
+        UartTxPoll();
     };
     return;
 }
 
 void __interrupt(high_priority) HighIsr(void){
+    // servo edges first, their timing is what keeps jitter low
+    if(ServoIF){
+        ServoInterruptHandler();
+        ServoIntDone();
+    }
     if(BUTTON_IF){ 
-        rotate_pick_motor();
+        // main() picks and logs, see service_button()
+        button_pressed = 1;
         ButtonIntDone();
     }
     if(Timer2IF){
         Timer2IntDone();
     }
+#if SERVO_SETTLE_FEEDBACK
+    if(ADC_IF){
+        AdcStoreResult();
+        AdcIntDone();
+    }
+#endif
 }
 
 void __interrupt(low_priority) LowIsr(void){
 
     if(Timer1IF){
-        Timer1IntDone();
+        Timer1InterruptHandler();
     }
     if(RCIF){
-        UartReceiveChar();
-        char ch = UartGetChar();
+        unsigned char byte = UartReceiveByte();
+        char ch = '\0';
+
+        // a lost note byte must not swallow the first byte of the next command
+        if(live_note_pending && (byte == '\r' || Timer1GetMillis() - live_note_at > LIVE_NOTE_TIMEOUT_MS)){
+            live_note_pending = 0;
+        }
+
+        // live events never reach the line buffer, commands are plain ASCII
+        if(live_note_pending){
+            live_note_pending = 0;
+            play_live_note(byte);
+        } else if(byte == LIVE_NOTE_ON){
+            live_note_pending = 1;
+            live_note_at = Timer1GetMillis();
+        } else {
+            UartBufferChar(byte);
+            ch = UartGetChar();
+        }
 
         // enter received
         if(ch == '\r'){
+            // nothing else is read until the command is handled
+            UartRtsHold();
             char str[UART_BUFFER_SIZE];
             UartCopyBufferToString(str);
 
             int pitch_val, base_val, delta_val;
-            if(strcmp(str, "reset\r") == 0){
+#if SERVO_CHANNEL_MASK
+            int channel_val;
+#endif
+            // armed boards start on one short line so every board in an ensemble starts together,
+            // a whole line so a stray 'g' in other traffic can't set them off
+            if(UartLineOverflowed()){
+                // what is left of a cut off line could parse as a different command
+                UartSendString("Line too long, discarded, must be at most ");
+                UartSendInt(UART_BUFFER_SIZE - 2);
+                UartSendString(" characters\n\r");
+                UartSendString("<end>");
+            } else if(is_armed && strcmp(str, "go\r") == 0){
+                is_armed = 0;
+                UartSendString("<go>");
+                wait_until(Timer1GetMillis() + arm_delay_ms);
+                play_midi(LATENCY_START_LEAD_MS);
+                UartSendString("<done><end>");
+            } else if(strcmp(str, "reset\r") == 0){
                 reset();
                 UartSendString("<end>");
+            } else if(strcmp(str, "echo off\r") == 0 || strcmp(str, "echo on\r") == 0){
+                // echoed, a streamed command plus its reply is more than comes in and the TX queue
+                // fills up; hosts streaming commands turn the echo off, reset() keeps it
+                UartSetEcho(str[6] == 'n');
+                UartSendString("<end>");
+            } else if(strcmp(str, "status\r") == 0){
+                UartSendString("UART overruns: ");
+                UartSendUnsigned(UartGetOverrunCount());
+                UartSendString(", dropped: ");
+                UartSendUnsigned(UartGetDroppedCount());
+                UartSendString(", CTS timeouts: ");
+                UartSendUnsigned(UartGetCtsTimeoutCount());
+                UartSendString("\n\r");
+#if SERVO_SETTLE_FEEDBACK
+                AdcStartConversion();
+                __delay_ms(1);
+                UartSendString("Servo position: ");
+                UartSendInt(AdcGetResult());
+                UartSendString(", settle saved: ");
+                UartSendLong(settle_saved_ms);
+                UartSendString(" ms\n\r");
+#endif
+                UartSendString("<end>");
             } else if(sscanf(str, "pitch set pulse width us %d", &pitch_val) == 1) {
                 if(MOTOR_NEG_90_DEG_US <= pitch_val && pitch_val <= MOTOR_POS_90_DEG_US){
                     PWMSetDutyCycle(pitch_val);
@@ -232,6 +518,34 @@ void __interrupt(low_priority) LowIsr(void){
                     UartSendString("Failed to set pitch motor degree, must be between -90 and 90\n\r");
                 }
                 UartSendString("<end>");
+#if SERVO_CHANNEL_MASK
+            } else if(sscanf(str, "servo %d set pulse width us %d", &channel_val, &pitch_val) == 2) {
+                if(servo_channel_ok(channel_val)){
+                    ServoSetPulseWidth(channel_val, pitch_val);
+                    UartSendString("Set servo ");
+                    UartSendInt(channel_val);
+                    UartSendString(" pulse width to ");
+                    UartSendInt(ServoGetPulseWidth(channel_val));
+                    UartSendString(" us\n\r");
+                } else {
+                    UartSendString("Failed to set servo pulse width, channel not in SERVO_CHANNEL_MASK\n\r");
+                }
+                UartSendString("<end>");
+            } else if(sscanf(str, "servo %d set degree %d", &channel_val, &pitch_val) == 2) {
+                if(!servo_channel_ok(channel_val)){
+                    UartSendString("Failed to set servo degree, channel not in SERVO_CHANNEL_MASK\n\r");
+                } else if(-90 <= pitch_val && pitch_val <= 90){
+                    ServoRotateDegree(channel_val, pitch_val);
+                    UartSendString("Set servo ");
+                    UartSendInt(channel_val);
+                    UartSendString(" degree to ");
+                    UartSendInt(pitch_val);
+                    UartSendString(" degree\n\r");
+                } else {
+                    UartSendString("Failed to set servo degree, must be between -90 and 90\n\r");
+                }
+                UartSendString("<end>");
+#endif
             } else if(sscanf(str, "pick set base degree %d", &base_val) == 1) {
                 if(-90 <= base_val && base_val <= 90){
                     base_degree = base_val;
@@ -263,9 +577,30 @@ void __interrupt(low_priority) LowIsr(void){
             } else if(strncmp(str, "play", 4) == 0) {
                 char play_str[UART_BUFFER_SIZE];
                 strcpy(play_str, str + 5);
+                unsigned int arm_val = 0, code_val = 0;
                 if(strcmp(play_str, "start\r") == 0){
-                    play_midi();
+                    play_midi(0);
                     UartSendString("<done><end>");
+                } else if(strcmp(play_str, "arm\r") == 0 || sscanf(play_str, "arm %u", &arm_val) == 1){
+                    arm_delay_ms = arm_val;
+                    is_armed = 1;
+                    UartSendString("<armed><end>");
+                } else if(pending_code > 0){
+                    parse_code(play_str);
+                    UartSendString("<end>");
+                } else if(sscanf(play_str, "code %u", &code_val) == 1){
+                    // bytecode replaces whatever was uploaded, CALL addresses count from 0
+                    if(code_val <= SONG_CODE_SIZE){
+                        SongClear();
+                        pending_notes = 0;
+                        pending_code = code_val;
+                        UartSendString("<ready><end>");
+                    } else {
+                        UartSendString("Failed to load song code, must be at most ");
+                        UartSendInt(SONG_CODE_SIZE);
+                        UartSendString(" bytes\n\r");
+                        UartSendString("<end>");
+                    }
                 } else if(pending_notes == 0){
                     pending_notes = atoi(play_str);
                     UartSendString("<ready><end>");
@@ -0,0 +1,166 @@
+import glob
+import sys
+import time
+from dataclasses import dataclass, field
+
+import mido
+
+# start.py has always played 1 tick as 0.5ms, keep the same tempo by default
+MS_PER_TICK = 0.5
+# shortest note kept, a 32nd note whatever the file's ticks per beat (60 ticks at 480 ppq)
+MIN_DURATION_BEATS = 0.125
+MAX_DELAY_MS = 4095     # largest value delay() in main.c can wait
+
+
+@dataclass
+class Note:
+    start: int      # absolute tick
+    end: int        # absolute tick
+    note: int
+    velocity: int = 64
+    track: int = 0
+
+    @property
+    def duration(self):
+        return self.end - self.start
+
+
+@dataclass
+class MelodyReport:
+    total: int = 0
+    kept: int = 0
+    masked: int = 0         # dropped because a higher note sounded at the same time
+    too_short: int = 0      # dropped because shorter than the minimum duration
+    clamped: int = 0        # moved into the calibrated range
+    clamped_notes: list = field(default_factory=list)
+
+    @property
+    def dropped(self):
+        return self.masked + self.too_short
+
+    def __str__(self):
+        return (f"{self.kept}/{self.total} notes kept, {self.dropped} dropped "
+                f"({self.masked} masked, {self.too_short} too short), {self.clamped} clamped")
+
+
+def extract_notes(midi_file: mido.MidiFile, tracks=None, channels=None):
+    # Turn note_on/note_off pairs into intervals with absolute tick times
+    notes = []
+    for i, track in enumerate(midi_file.tracks):
+        if tracks is not None and i not in tracks:
+            continue
+
+        tick = 0
+        sounding = {}   # (channel, note) -> (start, velocity)
+        for message in track:
+            tick += message.time
+            if message.type in ['note_on', 'note_off'] and channels is not None and message.channel not in channels:
+                continue
+            if message.type == 'note_on' and message.velocity > 0:
+                key = (message.channel, message.note)
+                # Retrigger of a sounding note closes the previous one
+                if key in sounding:
+                    start, velocity = sounding.pop(key)
+                    notes.append(Note(start, tick, message.note, velocity, i))
+                sounding[key] = (tick, message.velocity)
+            elif message.type in ['note_on', 'note_off']:
+                key = (message.channel, message.note)
+                if key in sounding:
+                    start, velocity = sounding.pop(key)
+                    notes.append(Note(start, tick, message.note, velocity, i))
+
+        # Close notes left hanging at the end of the track
+        for (_, note), (start, velocity) in sounding.items():
+            notes.append(Note(start, tick, note, velocity, i))
+
+    return notes
+
+
+def clamp_note(note: int, playable):
+    # Fold by octaves into the playable range, then snap to the nearest calibrated note
+    low, high = playable[0], playable[-1]
+    while note < low:
+        note += 12
+    while note > high:
+        note -= 12
+    if note < low:
+        note = low
+    if note in playable:
+        return note
+    return min(playable, key=lambda n: (abs(n - note), n))
+
+
+def skyline(notes, min_duration: int, playable=None):
+    """
+    Reduce polyphonic notes to a single line: the highest note at each onset wins,
+    a lower note starting under a sounding higher one is masked, and each kept note
+    is cut at the next kept onset. Notes shorter than min_duration ticks are dropped
+    first, so a grace note cannot mask the note it decorates. Sorting dominates, so
+    this runs in O(n log n).
+    """
+    report = MelodyReport(total=len(notes))
+    long_enough = [note for note in notes if note.duration >= min_duration]
+    report.too_short = len(notes) - len(long_enough)
+    ordered = sorted(long_enough, key=lambda n: (n.start, -n.note))
+
+    line = []
+    for note in ordered:
+        if line:
+            prev = line[-1]
+            if note.start == prev.start:
+                # Same onset, the first (highest) note was already taken
+                report.masked += 1
+                continue
+            if note.start < prev.end and note.note < prev.note:
+                report.masked += 1
+                continue
+            if note.start < prev.end:
+                prev.end = note.start
+        line.append(Note(note.start, note.end, note.note, note.velocity, note.track))
+
+    melody = line
+    if playable:
+        playable = sorted(playable)
+        for note in melody:
+            clamped = clamp_note(note.note, playable)
+            if clamped != note.note:
+                report.clamped += 1
+                report.clamped_notes.append((note.start, note.note, clamped))
+                note.note = clamped
+
+    report.kept = len(melody)
+    return melody, report
+
+
+def to_note_delays(melody, ms_per_tick: float = MS_PER_TICK):
+    # Each delay is the time from this note's onset to the next one, as play_midi() expects
+    result = []
+    for i, note in enumerate(melody):
+        if i + 1 < len(melody):
+            ticks = melody[i + 1].start - note.start
+        else:
+            ticks = note.duration
+        result.append((note.note, min(int(ticks * ms_per_tick), MAX_DELAY_MS)))
+    return result
+
+
+def extract_melody(midi_file: mido.MidiFile, playable=None, min_duration_beats: float = MIN_DURATION_BEATS,
+                   ms_per_tick: float = MS_PER_TICK, tracks=None, channels=None):
+    min_duration = round(min_duration_beats * midi_file.ticks_per_beat)
+    melody, report = skyline(extract_notes(midi_file, tracks, channels), min_duration, playable)
+    return to_note_delays(melody, ms_per_tick), report
+
+
+if __name__ == "__main__":
+    # Usage: python melody.py [file.mid ...], defaults to the whole midi/ library
+    from calibrate import load_pitch_model
+    from start import NOTE_TO_PWM
+
+    playable = load_pitch_model(NOTE_TO_PWM).playable_notes()
+    files = sys.argv[1:] or sorted(glob.glob('midi/*.mid'))
+    begin = time.perf_counter()
+    for path in files:
+        notes, report = extract_melody(mido.MidiFile(path), playable=playable)
+        print(f"{path}: {report}")
+    elapsed = time.perf_counter() - begin
+    print(f"Extracted {len(files)} files in {elapsed * 1000:.1f} ms")
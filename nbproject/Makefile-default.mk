@@ -51,17 +51,17 @@ OBJECTDIR=build/${CND_CONF}/${IMAGE_TYPE}
 DISTDIR=dist/${CND_CONF}/${IMAGE_TYPE}
 
 # Source Files Quoted if spaced
-SOURCEFILES_QUOTED_IF_SPACED=utils/adc.c utils/ccp.c utils/interrupt_manager.c utils/led.c utils/settings.c utils/timer.c utils/uart.c main.c
+SOURCEFILES_QUOTED_IF_SPACED=utils/adc.c utils/ccp.c utils/interrupt_manager.c utils/led.c utils/servo.c utils/settings.c utils/song.c utils/timer.c utils/uart.c main.c
 
 # Object Files Quoted if spaced
-OBJECTFILES_QUOTED_IF_SPACED=${OBJECTDIR}/utils/adc.p1 ${OBJECTDIR}/utils/ccp.p1 ${OBJECTDIR}/utils/interrupt_manager.p1 ${OBJECTDIR}/utils/led.p1 ${OBJECTDIR}/utils/settings.p1 ${OBJECTDIR}/utils/timer.p1 ${OBJECTDIR}/utils/uart.p1 ${OBJECTDIR}/main.p1
-POSSIBLE_DEPFILES=${OBJECTDIR}/utils/adc.p1.d ${OBJECTDIR}/utils/ccp.p1.d ${OBJECTDIR}/utils/interrupt_manager.p1.d ${OBJECTDIR}/utils/led.p1.d ${OBJECTDIR}/utils/settings.p1.d ${OBJECTDIR}/utils/timer.p1.d ${OBJECTDIR}/utils/uart.p1.d ${OBJECTDIR}/main.p1.d
+OBJECTFILES_QUOTED_IF_SPACED=${OBJECTDIR}/utils/adc.p1 ${OBJECTDIR}/utils/ccp.p1 ${OBJECTDIR}/utils/interrupt_manager.p1 ${OBJECTDIR}/utils/led.p1 ${OBJECTDIR}/utils/servo.p1 ${OBJECTDIR}/utils/settings.p1 ${OBJECTDIR}/utils/song.p1 ${OBJECTDIR}/utils/timer.p1 ${OBJECTDIR}/utils/uart.p1 ${OBJECTDIR}/main.p1
+POSSIBLE_DEPFILES=${OBJECTDIR}/utils/adc.p1.d ${OBJECTDIR}/utils/ccp.p1.d ${OBJECTDIR}/utils/interrupt_manager.p1.d ${OBJECTDIR}/utils/led.p1.d ${OBJECTDIR}/utils/servo.p1.d ${OBJECTDIR}/utils/settings.p1.d ${OBJECTDIR}/utils/song.p1.d ${OBJECTDIR}/utils/timer.p1.d ${OBJECTDIR}/utils/uart.p1.d ${OBJECTDIR}/main.p1.d
 
 # Object Files
-OBJECTFILES=${OBJECTDIR}/utils/adc.p1 ${OBJECTDIR}/utils/ccp.p1 ${OBJECTDIR}/utils/interrupt_manager.p1 ${OBJECTDIR}/utils/led.p1 ${OBJECTDIR}/utils/settings.p1 ${OBJECTDIR}/utils/timer.p1 ${OBJECTDIR}/utils/uart.p1 ${OBJECTDIR}/main.p1
+OBJECTFILES=${OBJECTDIR}/utils/adc.p1 ${OBJECTDIR}/utils/ccp.p1 ${OBJECTDIR}/utils/interrupt_manager.p1 ${OBJECTDIR}/utils/led.p1 ${OBJECTDIR}/utils/servo.p1 ${OBJECTDIR}/utils/settings.p1 ${OBJECTDIR}/utils/song.p1 ${OBJECTDIR}/utils/timer.p1 ${OBJECTDIR}/utils/uart.p1 ${OBJECTDIR}/main.p1
 
 # Source Files
-SOURCEFILES=utils/adc.c utils/ccp.c utils/interrupt_manager.c utils/led.c utils/settings.c utils/timer.c utils/uart.c main.c
+SOURCEFILES=utils/adc.c utils/ccp.c utils/interrupt_manager.c utils/led.c utils/servo.c utils/settings.c utils/song.c utils/timer.c utils/uart.c main.c
 
 
 
@@ -128,6 +128,14 @@ ${OBJECTDIR}/utils/settings.p1: utils/settings.c  nbproject/Makefile-${CND_CONF}
 	@-${MV} ${OBJECTDIR}/utils/settings.d ${OBJECTDIR}/utils/settings.p1.d 
 	@${FIXDEPS} ${OBJECTDIR}/utils/settings.p1.d $(SILENT) -rsi ${MP_CC_DIR}../  
 	
+${OBJECTDIR}/utils/song.p1: utils/song.c  nbproject/Makefile-${CND_CONF}.mk 
+	@${MKDIR} "${OBJECTDIR}/utils" 
+	@${RM} ${OBJECTDIR}/utils/song.p1.d 
+	@${RM} ${OBJECTDIR}/utils/song.p1 
+	${MP_CC} $(MP_EXTRA_CC_PRE) -mcpu=$(MP_PROCESSOR_OPTION) -c  -D__DEBUG=1  -mdebugger=none   -mdfp="${DFP_DIR}/xc8"  -fno-short-double -fno-short-float -memi=wordwrite -O0 -fasmfile -maddrqual=ignore -xassembler-with-cpp -mwarn=-3 -Wa,-a -DXPRJ_default=$(CND_CONF)  -msummary=-psect,-class,+mem,-hex,-file  -ginhx32 -Wl,--data-init -mno-keep-startup -mno-download -mno-default-config-bits $(COMPARISON_BUILD)  -std=c99 -gdwarf-3 -mstack=compiled:auto:auto:auto     -o ${OBJECTDIR}/utils/song.p1 utils/song.c 
+	@-${MV} ${OBJECTDIR}/utils/song.d ${OBJECTDIR}/utils/song.p1.d 
+	@${FIXDEPS} ${OBJECTDIR}/utils/song.p1.d $(SILENT) -rsi ${MP_CC_DIR}../  
+	
 ${OBJECTDIR}/utils/timer.p1: utils/timer.c  nbproject/Makefile-${CND_CONF}.mk 
 	@${MKDIR} "${OBJECTDIR}/utils" 
 	@${RM} ${OBJECTDIR}/utils/timer.p1.d 
@@ -144,6 +152,14 @@ ${OBJECTDIR}/utils/uart.p1: utils/uart.c  nbproject/Makefile-${CND_CONF}.mk
 	@-${MV} ${OBJECTDIR}/utils/uart.d ${OBJECTDIR}/utils/uart.p1.d 
 	@${FIXDEPS} ${OBJECTDIR}/utils/uart.p1.d $(SILENT) -rsi ${MP_CC_DIR}../  
 	
+${OBJECTDIR}/utils/servo.p1: utils/servo.c  nbproject/Makefile-${CND_CONF}.mk 
+	@${MKDIR} "${OBJECTDIR}/utils" 
+	@${RM} ${OBJECTDIR}/utils/servo.p1.d 
+	@${RM} ${OBJECTDIR}/utils/servo.p1 
+	${MP_CC} $(MP_EXTRA_CC_PRE) -mcpu=$(MP_PROCESSOR_OPTION) -c  -D__DEBUG=1  -mdebugger=none   -mdfp="${DFP_DIR}/xc8"  -fno-short-double -fno-short-float -memi=wordwrite -O0 -fasmfile -maddrqual=ignore -xassembler-with-cpp -mwarn=-3 -Wa,-a -DXPRJ_default=$(CND_CONF)  -msummary=-psect,-class,+mem,-hex,-file  -ginhx32 -Wl,--data-init -mno-keep-startup -mno-download -mno-default-config-bits $(COMPARISON_BUILD)  -std=c99 -gdwarf-3 -mstack=compiled:auto:auto:auto     -o ${OBJECTDIR}/utils/servo.p1 utils/servo.c 
+	@-${MV} ${OBJECTDIR}/utils/servo.d ${OBJECTDIR}/utils/servo.p1.d 
+	@${FIXDEPS} ${OBJECTDIR}/utils/servo.p1.d $(SILENT) -rsi ${MP_CC_DIR}../  
+	
 ${OBJECTDIR}/main.p1: main.c  nbproject/Makefile-${CND_CONF}.mk 
 	@${MKDIR} "${OBJECTDIR}" 
 	@${RM} ${OBJECTDIR}/main.p1.d 
@@ -193,6 +209,14 @@ ${OBJECTDIR}/utils/settings.p1: utils/settings.c  nbproject/Makefile-${CND_CONF}
 	@-${MV} ${OBJECTDIR}/utils/settings.d ${OBJECTDIR}/utils/settings.p1.d 
 	@${FIXDEPS} ${OBJECTDIR}/utils/settings.p1.d $(SILENT) -rsi ${MP_CC_DIR}../  
 	
+${OBJECTDIR}/utils/song.p1: utils/song.c  nbproject/Makefile-${CND_CONF}.mk 
+	@${MKDIR} "${OBJECTDIR}/utils" 
+	@${RM} ${OBJECTDIR}/utils/song.p1.d 
+	@${RM} ${OBJECTDIR}/utils/song.p1 
+	${MP_CC} $(MP_EXTRA_CC_PRE) -mcpu=$(MP_PROCESSOR_OPTION) -c   -mdfp="${DFP_DIR}/xc8"  -fno-short-double -fno-short-float -memi=wordwrite -O0 -fasmfile -maddrqual=ignore -xassembler-with-cpp -mwarn=-3 -Wa,-a -DXPRJ_default=$(CND_CONF)  -msummary=-psect,-class,+mem,-hex,-file  -ginhx32 -Wl,--data-init -mno-keep-startup -mno-download -mno-default-config-bits $(COMPARISON_BUILD)  -std=c99 -gdwarf-3 -mstack=compiled:auto:auto:auto     -o ${OBJECTDIR}/utils/song.p1 utils/song.c 
+	@-${MV} ${OBJECTDIR}/utils/song.d ${OBJECTDIR}/utils/song.p1.d 
+	@${FIXDEPS} ${OBJECTDIR}/utils/song.p1.d $(SILENT) -rsi ${MP_CC_DIR}../  
+	
 ${OBJECTDIR}/utils/timer.p1: utils/timer.c  nbproject/Makefile-${CND_CONF}.mk 
 	@${MKDIR} "${OBJECTDIR}/utils" 
 	@${RM} ${OBJECTDIR}/utils/timer.p1.d 
@@ -209,6 +233,14 @@ ${OBJECTDIR}/utils/uart.p1: utils/uart.c  nbproject/Makefile-${CND_CONF}.mk
 	@-${MV} ${OBJECTDIR}/utils/uart.d ${OBJECTDIR}/utils/uart.p1.d 
 	@${FIXDEPS} ${OBJECTDIR}/utils/uart.p1.d $(SILENT) -rsi ${MP_CC_DIR}../  
 	
+${OBJECTDIR}/utils/servo.p1: utils/servo.c  nbproject/Makefile-${CND_CONF}.mk 
+	@${MKDIR} "${OBJECTDIR}/utils" 
+	@${RM} ${OBJECTDIR}/utils/servo.p1.d 
+	@${RM} ${OBJECTDIR}/utils/servo.p1 
+	${MP_CC} $(MP_EXTRA_CC_PRE) -mcpu=$(MP_PROCESSOR_OPTION) -c   -mdfp="${DFP_DIR}/xc8"  -fno-short-double -fno-short-float -memi=wordwrite -O0 -fasmfile -maddrqual=ignore -xassembler-with-cpp -mwarn=-3 -Wa,-a -DXPRJ_default=$(CND_CONF)  -msummary=-psect,-class,+mem,-hex,-file  -ginhx32 -Wl,--data-init -mno-keep-startup -mno-download -mno-default-config-bits $(COMPARISON_BUILD)  -std=c99 -gdwarf-3 -mstack=compiled:auto:auto:auto     -o ${OBJECTDIR}/utils/servo.p1 utils/servo.c 
+	@-${MV} ${OBJECTDIR}/utils/servo.d ${OBJECTDIR}/utils/servo.p1.d 
+	@${FIXDEPS} ${OBJECTDIR}/utils/servo.p1.d $(SILENT) -rsi ${MP_CC_DIR}../  
+	
 ${OBJECTDIR}/main.p1: main.c  nbproject/Makefile-${CND_CONF}.mk 
 	@${MKDIR} "${OBJECTDIR}" 
 	@${RM} ${OBJECTDIR}/main.p1.d 
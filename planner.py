@@ -0,0 +1,236 @@
+import re
+import sys
+from dataclasses import dataclass
+
+# Servo speed model: ~0.1s per 60 degrees, 180 degrees span 500~2400us, latency.py
+# builds latency_table.h from it until the servos are measured
+SERVO_US_PER_MS = 6.3
+SERVO_SETTLE_MS = 5
+# PITCH_REST_US in main.c, play_midi() parks the pitch servo there before every note
+PITCH_REST_US = 900
+LATENCY_TABLE_HEADER = 'utils/latency_table.h'
+
+TRANSPOSE_RANGE = range(-12, 13)
+# Ties keep the written octave
+OCTAVE_SHIFTS = (0, -12, 12, -24, 24)
+PHRASE_GAP_FACTOR = 1.5
+PHRASE_MAX_NOTES = 16
+
+
+@dataclass
+class Lags:
+    # The lags play_midi() schedules with, see latency_table.h
+    pick_ms: int        # the slower stroke, the direction of each pick isn't planned
+    step_us: int
+    up_ms: list
+    down_ms: list
+
+    def pitch_ms(self, from_pwm, to_pwm):
+        # As LatencyPitchUpMs/DownMs: the jump rounds up to the next step, the last step covers the rest
+        table = self.up_ms if to_pwm >= from_pwm else self.down_ms
+        return table[min(-(-abs(to_pwm - from_pwm) // self.step_us), len(table) - 1)]
+
+    def lead_ms(self, from_pwm, to_pwm):
+        # How long before its onset play_midi() starts a note: the pitch servo goes by way of
+        # the rest pulse, the pick starts early by its own lag, whichever is first
+        rest_ms = 0 if from_pwm is None else self.pitch_ms(from_pwm, PITCH_REST_US)
+        return max(rest_ms + self.pitch_ms(PITCH_REST_US, to_pwm), self.pick_ms)
+
+
+def read_lags(header: str = LATENCY_TABLE_HEADER):
+    with open(header, 'r', encoding='utf-8') as f:
+        text = f.read()
+    defines = dict(re.findall(r'#define (LATENCY_\w+) (\d+)', text))
+    tables = {name: [int(value) for value in re.findall(r'\d+', body)]
+              for name, body in re.findall(r'latency_(pitch_\w+)_ms\[\] = \{(.*?)\};', text, re.S)}
+    return Lags(max(int(defines['LATENCY_PICK_RISE_MS']), int(defines['LATENCY_PICK_FALL_MS'])),
+                int(defines['LATENCY_JUMP_STEP_US']), tables['pitch_up'], tables['pitch_down'])
+
+
+def late_ms(lags: Lags, from_pwm, to_pwm, delay_ms):
+    # How late the next note sounds when the previous one only leaves delay_ms for its lead
+    return max(0, lags.lead_ms(from_pwm, to_pwm) - delay_ms)
+
+
+@dataclass
+class Plan:
+    notes: list         # [(note, delay_ms)] after transposition and octave shifts
+    transpose: int
+    shifts: list        # octave shift in semitones per phrase
+    phrases: list       # (start, end) note index of each phrase
+    max_late_ms: float
+    total_late_ms: float
+    tempo_factor: float
+
+    def __str__(self):
+        return (f"transpose {self.transpose:+d}, octave shifts {self.shifts}, "
+                f"max late {self.max_late_ms:.0f}ms, total late {self.total_late_ms:.0f}ms, "
+                f"max tempo x{self.tempo_factor:.2f}")
+
+
+def split_phrases(notes):
+    # A phrase ends after a note held noticeably longer than usual, or after PHRASE_MAX_NOTES notes
+    if not notes:
+        return []
+    delays = sorted(delay for _, delay in notes)
+    gap = delays[len(delays) // 2] * PHRASE_GAP_FACTOR
+
+    phrases = []
+    start = 0
+    for i, (_, delay) in enumerate(notes):
+        if delay > gap or i + 1 - start >= PHRASE_MAX_NOTES or i == len(notes) - 1:
+            phrases.append((start, i + 1))
+            start = i + 1
+    return phrases
+
+
+def phrase_cost(pwms, delays, lags: Lags):
+    # Worst and total lateness inside one phrase, None when a note can't be played
+    if any(pwm is None for pwm in pwms):
+        return None
+    late = [late_ms(lags, a, b, delay) for a, b, delay in zip(pwms, pwms[1:], delays)]
+    return max(late, default=0), sum(late)
+
+
+def plan_transpose(notes, phrases, transpose, pwm_of, lags: Lags):
+    # candidates[k] = [(shift, first_pwm, last_pwm, max_ms, total_ms)] for phrase k
+    candidates = []
+    for start, end in phrases:
+        options = []
+        delays = [delay for _, delay in notes[start:end]]
+        for shift in OCTAVE_SHIFTS:
+            pwms = [pwm_of(note + transpose + shift) for note, _ in notes[start:end]]
+            cost = phrase_cost(pwms, delays, lags)
+            if cost is not None:
+                options.append((shift, pwms[0], pwms[-1], cost[0], cost[1]))
+        if not options:
+            return None
+        candidates.append(options)
+
+    # The note ending phrase k - 1 leaves its delay for the jump into phrase k
+    boundary_delays = [notes[start - 1][1] for start, _ in phrases]
+
+    # Pass 1: the smallest achievable worst lateness (max composes along the path)
+    best_max = [option[3] for option in candidates[0]]
+    for k in range(1, len(candidates)):
+        best_max = [
+            min(max(best_max[j], late_ms(lags, prev[2], option[1], boundary_delays[k]), option[3])
+                for j, prev in enumerate(candidates[k - 1]))
+            for option in candidates[k]
+        ]
+    limit = min(best_max)
+
+    # Pass 2: least total lateness among paths that never exceed that worst case
+    inf = float('inf')
+    total = [option[4] if option[3] <= limit else inf for option in candidates[0]]
+    back = [[None] * len(options) for options in candidates]
+    for k in range(1, len(candidates)):
+        next_total = []
+        for i, option in enumerate(candidates[k]):
+            best, best_j = inf, None
+            if option[3] <= limit:
+                for j, prev in enumerate(candidates[k - 1]):
+                    jump = late_ms(lags, prev[2], option[1], boundary_delays[k])
+                    if jump <= limit and total[j] + jump < best:
+                        best, best_j = total[j] + jump, j
+            next_total.append(best + option[4])
+            back[k][i] = best_j
+        total = next_total
+
+    i = min(range(len(total)), key=lambda i: total[i])
+    path = [i]
+    for k in range(len(candidates) - 1, 0, -1):
+        i = back[k][i]
+        path.append(i)
+    path.reverse()
+
+    shifts = [candidates[k][i][0] for k, i in enumerate(path)]
+    return limit, total[path[-1]], shifts
+
+
+def tempo_factor(notes, pwm_of, lags: Lags = None):
+    # How much faster than written the song can go before play_midi() starts a note late,
+    # below 1 some notes are late at the written tempo already
+    lags = lags or read_lags()
+    factor = float('inf')
+    prev_pwm = None
+    for i, (note, delay) in enumerate(notes):
+        pwm = pwm_of(note)
+        if i > 0:
+            factor = min(factor, notes[i - 1][1] / lags.lead_ms(prev_pwm, pwm))
+        prev_pwm = pwm
+    return factor if factor != float('inf') else 1.0
+
+
+def warn_tempo(factor: float):
+    if factor < 1:
+        print(f"\033[93mSome notes need more lead than their delay leaves, they sound late "
+              f"unless played at x{factor:.2f} the written tempo\033[0m")
+
+
+def shared_transpose(parts, pwm_of, lags: Lags = None):
+    """
+    One transposition for several melodies played together, so every board stays
+    in the same key. Minimizes the worst, then the total, lateness over all parts,
+    ties keep the smaller transposition. Returns None if no transposition fits every part.
+    """
+    lags = lags or read_lags()
+    parts = [notes for notes in parts if notes]
+    phrases = [split_phrases(notes) for notes in parts]
+    best = None
+    for transpose in sorted(TRANSPOSE_RANGE, key=abs):
+        results = [plan_transpose(notes, part_phrases, transpose, pwm_of, lags)
+                   for notes, part_phrases in zip(parts, phrases)]
+        if not results or None in results:
+            continue
+        cost = (max(result[0] for result in results), sum(result[1] for result in results))
+        if best is None or cost < best[0]:
+            best = (cost, transpose)
+    return best[1] if best else None
+
+
+def plan(notes, pwm_of, transpose=None, lags: Lags = None):
+    """
+    Pick a global transposition and per-phrase octave shifts that keep every note
+    playable while minimizing the worst, then the total, ms a note sounds late under
+    play_midi()'s schedule. Ties keep the smaller transposition, so a song that plays
+    on time stays in its key. A given transpose is kept as is, only the octave shifts
+    are planned. Returns None if no transposition fits the calibrated range.
+    """
+    if not notes:
+        return None
+
+    lags = lags or read_lags()
+    phrases = split_phrases(notes)
+    best = None
+    for transpose in sorted(TRANSPOSE_RANGE, key=abs) if transpose is None else [transpose]:
+        result = plan_transpose(notes, phrases, transpose, pwm_of, lags)
+        if result is None:
+            continue
+        max_ms, total_ms, shifts = result
+        if best is None or (max_ms, total_ms) < (best[0], best[1]):
+            best = (max_ms, total_ms, shifts, transpose)
+
+    if best is None:
+        return None
+
+    max_ms, total_ms, shifts, transpose = best
+    planned = []
+    for (start, end), shift in zip(phrases, shifts):
+        planned += [(note + transpose + shift, delay) for note, delay in notes[start:end]]
+    return Plan(planned, transpose, shifts, phrases, max_ms, total_ms, tempo_factor(planned, pwm_of, lags))
+
+
+if __name__ == "__main__":
+    # Usage: python planner.py file.mid
+    import mido
+
+    from calibrate import load_pitch_model
+    from melody import extract_melody
+    from start import NOTE_TO_PWM
+
+    notes, report = extract_melody(mido.MidiFile(sys.argv[1]))
+    result = plan(notes, load_pitch_model(NOTE_TO_PWM).pwm_of)
+    print(result if result else "No transposition fits the calibrated range")
+    if result:
+        warn_tempo(result.tempo_factor)
@@ -0,0 +1,179 @@
+import os
+import re
+import threading
+import time
+import tty
+
+from song import expand, format_item
+
+# Same values as main.c
+LIVE_NOTE_ON = 0x90
+LIVE_ACK_PLAYED = 0x80
+LIVE_SETTLE_S = 0.005
+LIVE_NOTE_TIMEOUT_S = 0.1
+
+
+class SimBoard:
+    """
+    Stand-in for the firmware's UART command interface on a pseudo terminal,
+    so host tools can run without hardware: open `board.port` with pyserial.
+    Replies mirror main.c (echo, <end> markers); playback only waits, no servos.
+    """
+
+    def __init__(self, baudrate: int = 0, time_scale: float = 1.0, name: str = 'sim'):
+        # baudrate 0 means replies are not throttled, time_scale shortens note delays
+        self.baudrate = baudrate
+        self.time_scale = time_scale
+        self.name = name
+        self.master, slave = os.openpty()
+        tty.setraw(slave)
+        self.port = os.ttyname(slave)
+        self._slave = slave
+        self.echo = True            # reset() keeps it, like main.c
+        self.reset()
+        self.started_at = None      # perf_counter() when the last playback began
+        self.played = []            # (value, delay) of the last playback
+        self.live_notes = []        # notes received as live events
+        self._running = True
+        self._thread = threading.Thread(target=self._run, daemon=True)
+        self._thread.start()
+
+    def reset(self):
+        self.notes = []
+        self.pending_notes = 0
+        self.code = b''
+        self.pending_code = 0
+        self.is_armed = False
+        self.arm_delay_ms = 0
+
+    def close(self):
+        self._running = False
+        os.close(self.master)
+        os.close(self._slave)
+
+    def _send(self, data: str):
+        for ch in data.encode('utf-8'):
+            os.write(self.master, bytes([ch]))
+            if self.baudrate:
+                time.sleep(10 / self.baudrate)
+
+    def _play(self):
+        if self.code:
+            # like the firmware, notes sent as text after the bytecode are never reached
+            self.notes = [(format_item(item).split(',')[0], item[2]) for item in expand(self.code)]
+        self.started_at = time.perf_counter()
+        self.played = list(self.notes)
+        # main.c logs nothing while playing, notes land on the grid of delays
+        for _, delay in self.notes:
+            time.sleep(delay / 1000 * self.time_scale)
+        self.notes = []
+        self.code = b''
+
+    def _command(self, line: str):
+        if self.is_armed and line == 'go':
+            self.is_armed = False
+            self._send('<go>')
+            time.sleep(self.arm_delay_ms / 1000 * self.time_scale)
+            self._play()
+            self._send('<done><end>')
+        elif line == 'reset':
+            self.reset()
+            self._send('<end>')
+        elif line in ('echo off', 'echo on'):
+            self.echo = line == 'echo on'
+            self._send('<end>')
+        elif line == 'status':
+            self._send('UART overruns: 0, dropped: 0, CTS timeouts: 0\n\r<end>')
+        elif line.startswith('pitch set') or line.startswith('pick'):
+            self._send('OK\n\r<end>')
+        elif line.startswith('play'):
+            arg = line[5:]
+            match = re.fullmatch(r'arm(?: (\d+))?', arg)
+            code = re.fullmatch(r'code (\d+)', arg)
+            if arg == 'start':
+                self._play()
+                self._send('<done><end>')
+            elif match:
+                self.is_armed = True
+                self.arm_delay_ms = int(match.group(1) or 0)
+                self._send('<armed><end>')
+            elif self.pending_code:
+                data = bytes.fromhex(arg)[:self.pending_code]
+                self.code += data
+                self.pending_code -= len(data)
+                self._send('<end>')
+            elif code:
+                self.notes, self.code = [], b''
+                self.pending_notes, self.pending_code = 0, int(code.group(1))
+                self._send('<ready><end>')
+            elif self.pending_notes == 0:
+                self.pending_notes = int(arg or 0)
+                self._send('<ready><end>')
+            else:
+                for item in arg.split(' '):
+                    match = re.fullmatch(r'(n?\d+),(\d+)', item)
+                    if not match or self.pending_notes == 0:
+                        break
+                    self.notes.append((match.group(1), int(match.group(2))))
+                    self.pending_notes -= 1
+                self._send('<end>')
+        else:
+            self._send('<end>')
+
+    def _live_note(self, note: int):
+        # Fixed settle time plus the pick, no servo model. A pty has no wire delay,
+        # so the event and the ack bytes are charged here when a baudrate is set
+        byte_s = 10 / self.baudrate if self.baudrate else 0
+        time.sleep(2 * byte_s + LIVE_SETTLE_S * self.time_scale)
+        self.live_notes.append(note)
+        time.sleep(byte_s)
+        os.write(self.master, bytes([LIVE_ACK_PLAYED]))
+
+    def _run(self):
+        line = ''
+        live_note_pending = False
+        live_note_at = 0
+        while self._running:
+            try:
+                data = os.read(self.master, 1)
+            except OSError:
+                return
+            if not data:
+                return
+
+            # like main.c, a lost note byte must not swallow the next command
+            if live_note_pending and (data == b'\r' or time.perf_counter() - live_note_at > LIVE_NOTE_TIMEOUT_S):
+                live_note_pending = False
+            if live_note_pending:
+                live_note_pending = False
+                self._live_note(data[0])
+                continue
+            if data[0] == LIVE_NOTE_ON:
+                live_note_pending = True
+                live_note_at = time.perf_counter()
+                continue
+            ch = data.decode('utf-8', errors='replace')
+
+            if self.echo:
+                if ch == '\r':
+                    self._send('\n')
+                self._send(ch)
+            if ch == '\r':
+                self._command(line)
+                line = ''
+            else:
+                line += ch
+
+
+if __name__ == "__main__":
+    # Usage: python simboard.py [count], prints the ports and serves until Ctrl+C
+    import sys
+
+    boards = [SimBoard(name=f'sim{i}') for i in range(int(sys.argv[1]) if len(sys.argv) > 1 else 1)]
+    for board in boards:
+        print(f"{board.name}: {board.port}")
+    try:
+        while True:
+            time.sleep(1)
+    except KeyboardInterrupt:
+        pass
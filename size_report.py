@@ -0,0 +1,316 @@
+import os
+import re
+import sys
+from dataclasses import dataclass, field
+
+BUILD_PREFIX = 'dist/default/debug/final_project.X.debug'
+# a map older than any of these describes some other firmware
+SOURCES = ['main.c', 'utils']
+
+# Limits checked by `make size-report`, override with name=value on the command line
+BUDGETS = {
+    'ram': 1400,            # bytes of the 1536 byte data memory, compiled stack included
+    'flash': 28672,         # bytes of the 32768 byte program memory
+    'eeprom': 256,          # bytes of EEPROM data
+    'stack_levels': 31,     # hardware return stack, main + LowIsr + HighIsr nested
+    'isr_ram': 128,         # compiled stack bytes of one ISR's deepest call path
+}
+
+RAM_CLASSES = {'COMRAM', 'BIGRAM', 'RAM', 'BANK0', 'BANK1', 'BANK2', 'BANK3', 'BANK4', 'BANK5'}
+ISRS = {'_HighIsr': 'HighIsr', '_LowIsr': 'LowIsr'}
+
+
+@dataclass
+class Psect:
+    name: str
+    cls: str
+    address: int
+    length: int
+
+
+@dataclass
+class Function:
+    name: str
+    ram: int = 0
+    stack_levels: int = 0
+    calls: list = field(default_factory=list)
+
+
+def parse_map(path: str):
+    """
+    Psects with their class, and the unused address ranges per class, from the
+    linker map. The TOTAL section lists each psect under its CLASS heading.
+    """
+    psects, unused, symbols = {}, {}, []
+    section, cls = None, None
+    with open(path, 'r', encoding='utf-8', errors='replace') as f:
+        for line in f:
+            if line.startswith('TOTAL'):
+                section = 'total'
+            elif line.startswith('SEGMENTS'):
+                section = None
+            elif line.startswith('UNUSED ADDRESS RANGES'):
+                section = 'unused'
+            elif line.strip() == 'Symbol Table':
+                section = 'symbols'
+            elif section == 'total':
+                match = re.match(r'\s+CLASS\s+(\S+)', line)
+                if match:
+                    cls = match.group(1)
+                    continue
+                fields = line.split()
+                if len(fields) == 5:
+                    psects[fields[0]] = Psect(fields[0], cls, int(fields[1], 16), int(fields[3], 16))
+            elif section == 'unused':
+                match = re.match(r'\s+(?:(\S+)\s+)?([0-9A-F]+)-([0-9A-F]+)\s+[0-9A-F]+$', line)
+                if match:
+                    cls = match.group(1) or cls
+                    unused.setdefault(cls, []).append((int(match.group(2), 16), int(match.group(3), 16)))
+            elif section == 'symbols':
+                fields = line.split()
+                if len(fields) == 3:
+                    symbols.append((fields[0], fields[1], int(fields[2], 16)))
+    return psects, unused, symbols
+
+
+def parse_sym(path: str):
+    # <name> <address> <?> <class> <space> per line
+    symbols = {}
+    with open(path, 'r', encoding='utf-8', errors='replace') as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) == 5:
+                symbols[fields[0]] = (int(fields[1], 16), fields[3])
+    return symbols
+
+
+def parse_sdb(path: str):
+    # The debug database names the source file of every global, in front of its [v ...] entry
+    modules = {}
+    if not os.path.exists(path):
+        return modules
+    source = None
+    with open(path, 'r', encoding='utf-8', errors='replace') as f:
+        for line in f:
+            match = re.match(r'"\d+ (.+)$', line)
+            if match:
+                source = match.group(1).strip()
+                continue
+            match = re.match(r'\[v (_\S+) ', line)
+            if match and source and match.group(1) not in modules:
+                modules[match.group(1)] = module_name(source)
+    return modules
+
+
+def module_name(source: str):
+    # Project files keep their relative path, compiler library sources collapse into one
+    if '/pic/sources/' in source or '/xc8/' in source:
+        return 'libc'
+    parts = source.replace('\\', '/').split('/')
+    return '/'.join(parts[-2:]) if len(parts) > 1 and parts[-2] == 'utils' else parts[-1]
+
+
+def parse_lst_modules(path: str):
+    """
+    Module of every label in the listing, for symbols the debug database misses.
+    XC8 interleaves the C source as ';file.c: line:' comments and marks the
+    data of each file with a 'file' directive, a label belongs to the last one seen.
+    """
+    modules = {}
+    if not os.path.exists(path):
+        return modules
+    source = None
+    with open(path, 'r', encoding='utf-8', errors='replace') as f:
+        for line in f:
+            match = re.search(r';\s*([\w./\\-]+\.[ch]):\s*\d+:', line) or re.search(r'\bfile\s+"([^"]+)"', line)
+            if match:
+                source = match.group(1)
+                continue
+            match = re.match(r'\s*\d+\s+[0-9A-Fa-f]+\s+(_\w+):\s*$', line)
+            if match and source and match.group(1) not in modules:
+                modules[match.group(1)] = module_name(source)
+    return modules
+
+
+def stale_sources(map_path: str):
+    # Sources changed since the map was linked
+    built = os.path.getmtime(map_path)
+    paths = []
+    for source in SOURCES:
+        if os.path.isdir(source):
+            paths += [os.path.join(source, name) for name in os.listdir(source) if name.endswith(('.c', '.h'))]
+        elif os.path.exists(source):
+            paths.append(source)
+    return sorted(path for path in paths if os.path.getmtime(path) > built)
+
+
+def parse_lst(path: str):
+    """
+    Per function compiled stack usage, hardware stack depth and callees from the
+    comment block XC8 writes in front of each function in the listing.
+    """
+    functions = {}
+    current, in_calls = None, False
+    if not os.path.exists(path):
+        return functions
+    with open(path, 'r', encoding='utf-8', errors='replace') as f:
+        for line in f:
+            match = re.search(r';; \*+ function (\S+) \*+', line)
+            if match:
+                current = functions.setdefault(match.group(1), Function(match.group(1)))
+                in_calls = False
+                continue
+            if current is None or ';;' not in line:
+                continue
+            comment = line.split(';;', 1)[1].strip()
+            if comment.startswith('Total ram usage:'):
+                current.ram = int(comment.split(':')[1].split()[0])
+            elif comment.startswith('Hardware stack levels'):
+                # leaf functions only have the "used" line
+                current.stack_levels = max(current.stack_levels, int(comment.split(':')[1]))
+            elif comment == 'This function calls:':
+                in_calls = True
+            elif in_calls and re.fullmatch(r'[\w$@]+', comment) and comment != 'Nothing':
+                current.calls.append(comment)
+            else:
+                in_calls = False
+    return functions
+
+
+def path_ram(functions, name: str, seen=frozenset()):
+    # Compiled stack frames on one call path are live together, siblings share memory
+    function = functions.get(name)
+    if function is None or name in seen:
+        return 0
+    return function.ram + max((path_ram(functions, callee, seen | {name}) for callee in function.calls), default=0)
+
+
+def ram_symbols(psects, map_symbols, modules):
+    # Statically allocated objects, sized by the distance to the next symbol in their psect
+    by_psect = {}
+    for name, psect, address in map_symbols:
+        if psect in psects and psects[psect].cls in RAM_CLASSES and not psect.startswith('cstack'):
+            if name.startswith('_') and not name.startswith('__'):
+                by_psect.setdefault(psect, {})[address] = name
+
+    rows = []
+    for psect, entries in by_psect.items():
+        end = psects[psect].address + psects[psect].length
+        addresses = sorted(entries) + [end]
+        for address, following in zip(addresses, addresses[1:]):
+            name = entries[address]
+            rows.append((name[1:], modules.get(name, 'unknown'), psect, following - address))
+    return sorted(rows, key=lambda row: (-row[3], row[0]))
+
+
+def code_functions(sym, psects, map_symbols, modules):
+    # A function ends at the __end_of label the compiler places after it. Interrupt
+    # functions start in the vector psect and continue elsewhere, count only the body
+    psect_of = {name: psect for name, psect, _ in map_symbols}
+    rows = []
+    for name, (address, cls) in sym.items():
+        end_name = '__end_of' + name
+        if cls != 'CODE' or end_name not in sym:
+            continue
+        end = sym[end_name][0]
+        psect = psects.get(psect_of.get(end_name))
+        if psect is not None and psect_of.get(name) != psect.name:
+            address = psect.address
+        if end > address:
+            # i1_ and i2_ are the copies XC8 makes of functions also called from an ISR
+            base = re.sub(r'^i\d', '', name)
+            rows.append((name.lstrip('_'), modules.get(base, 'unknown'), end - address))
+    return sorted(rows, key=lambda row: (-row[2], row[0]))
+
+
+def total_range(ranges):
+    return sum(end - start + 1 for start, end in ranges)
+
+
+def size_report(prefix: str = BUILD_PREFIX, budgets: dict | None = None):
+    budgets = {**BUDGETS, **(budgets or {})}
+    stale = stale_sources(prefix + '.map')
+    if stale:
+        print(f"\033[91m{prefix}.map is older than {', '.join(stale)}, rebuild first\033[0m")
+        return False
+    psects, unused, map_symbols = parse_map(prefix + '.map')
+    sym = parse_sym(prefix + '.sym')
+    # the debug database wins, the listing fills in what it leaves out
+    modules = {**parse_lst_modules(prefix + '.lst'), **parse_sdb(prefix + '.sdb')}
+    functions = parse_lst(prefix + '.lst')
+
+    # RAM
+    ram_psects = [p for p in psects.values() if p.cls in RAM_CLASSES]
+    ram_used = sum(p.length for p in ram_psects)
+    stack_ram = sum(p.length for p in ram_psects if p.name.startswith('cstack'))
+    symbols = ram_symbols(psects, map_symbols, modules)
+
+    print("\033[1mRAM by module\033[0m")
+    per_module = {}
+    for _, module, _, size in symbols:
+        per_module[module] = per_module.get(module, 0) + size
+    per_module['(compiled stack)'] = stack_ram
+    for module, size in sorted(per_module.items(), key=lambda item: -item[1]):
+        print(f"  {module:<28} {size:>6}")
+
+    print("\033[1mRAM by symbol\033[0m")
+    for name, module, psect, size in symbols:
+        print(f"  {name:<28} {module:<20} {psect:<14} {size:>6}")
+
+    # Stack
+    print("\033[1mStack per ISR\033[0m")
+    isr_levels, isr_ram = {}, {}
+    for symbol, label in ISRS.items():
+        function = functions.get(symbol)
+        if function is None:
+            print(f"  {label:<28} not in the listing")
+            continue
+        isr_levels[label] = function.stack_levels
+        isr_ram[label] = path_ram(functions, symbol)
+        print(f"  {label:<28} {function.stack_levels:>3} hardware levels, {isr_ram[label]:>4} bytes compiled stack")
+    main_levels = functions['_main'].stack_levels if '_main' in functions else 0
+    worst_levels = main_levels + sum(isr_levels.values())
+    print(f"  {'main + nested ISRs':<28} {worst_levels:>3} hardware levels")
+
+    # Program memory
+    print("\033[1mProgram memory by function\033[0m")
+    for name, module, size in code_functions(sym, psects, map_symbols, modules):
+        print(f"  {name:<28} {module:<20} {size:>6}")
+
+    flash_used = sum(p.length for p in psects.values() if p.cls in {'CODE', 'CONST', 'SMALLCONST', 'MEDIUMCONST'})
+    flash_free = total_range(unused.get('CODE', []))
+    eeprom_free = total_range(unused.get('EEDATA', []))
+    eeprom_used = sum(p.length for p in psects.values() if p.cls == 'EEDATA')
+    ram_free = total_range(unused.get('BIGRAM', []))
+    print("\033[1mFree memory\033[0m")
+    print(f"  {'flash':<28} {flash_free:>6} free, {flash_used} used")
+    print(f"  {'RAM':<28} {ram_free:>6} free, {ram_used} used ({stack_ram} compiled stack)")
+    print(f"  {'EEPROM':<28} {eeprom_free:>6} free, {eeprom_used} used")
+
+    # Budgets
+    checks = [
+        ('ram', 'ram', ram_used),
+        ('flash', 'flash', flash_used),
+        ('eeprom', 'eeprom', eeprom_used),
+        ('stack_levels', 'stack_levels', worst_levels),
+    ] + [(f'isr_ram {label}', 'isr_ram', used) for label, used in isr_ram.items()]
+    failed = [label for label, name, used in checks if used > budgets[name]]
+    print("\033[1mBudgets\033[0m")
+    for label, name, used in checks:
+        state = "\033[91mOVER\033[0m" if used > budgets[name] else "\033[92mok\033[0m"
+        print(f"  {label:<28} {used:>6} / {budgets[name]:<6} {state}")
+    if failed:
+        print(f"\033[91mOver budget: {', '.join(failed)}\033[0m")
+    return not failed
+
+
+if __name__ == "__main__":
+    # Usage: python size_report.py [build prefix] [budget=limit ...]
+    prefix, overrides = BUILD_PREFIX, {}
+    for arg in sys.argv[1:]:
+        if '=' in arg:
+            name, value = arg.split('=', 1)
+            overrides[name] = int(value)
+        else:
+            prefix = arg
+    sys.exit(0 if size_report(prefix, overrides) else 1)
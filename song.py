@@ -0,0 +1,510 @@
+import random
+import re
+import sys
+
+# Same values as utils/song.h
+SONG_CODE_SIZE = 256
+SONG_LOOP_DEPTH = 4
+SONG_CALL_DEPTH = 4
+SONG_MAX_CONTROL_OPS = 64
+SONG_MAX_LOOP_PASSES = 4096
+OP_PULSE = 0x80
+OP_REST = 0x81
+OP_LOOP = 0x82
+OP_END_LOOP = 0x83
+OP_CALL = 0x84
+OP_RETURN = 0x85
+OP_END = 0x86
+OP_UNIT = 0x87
+MAX_LOOP_COUNT = 255
+# longest run of symbols tried as a loop body or phrase, keeps compress() from going cubic
+# in the song length; a longer repeat is still found as phrases calling phrases
+MAX_REPEAT_SYMBOLS = 32
+# bytes per note in the NoteBuffer main.c used before the bytecode, two unsigned ints
+NOTE_BUFFER_BYTES_PER_NOTE = 4
+
+# hex bytes per 'play' line, the line buffer in utils/uart.h is 128 characters
+UPLOAD_BATCH = 48
+
+
+def parse_item(item: str):
+    # The 'play' upload format: n<note>,<delay>, <pulse width us>,<delay>, or r,<delay> for a rest
+    match = re.fullmatch(r'(n\d+|r|\d+),(\d+)', item)
+    if not match:
+        raise ValueError(f"Bad song item {item!r}")
+    head, delay = match.group(1), int(match.group(2))
+    if head == 'r':
+        return 'r', 0, delay
+    if head.startswith('n'):
+        return 'n', int(head[1:]), delay
+    return 'p', int(head), delay
+
+
+def format_item(item):
+    kind, value, delay = item
+    return {'n': f'n{value},{delay}', 'p': f'{value},{delay}', 'r': f'r,{delay}'}[kind]
+
+
+def varint(value: int):
+    data = bytearray()
+    while value >= 0x80:
+        data.append((value & 0x7F) | 0x80)
+        value >>= 7
+    data.append(value)
+    return bytes(data)
+
+
+def flat_size(items):
+    # bytes the same notes take as plain note opcodes, what the 'play' text upload is stored as
+    return sum(symbol_size(item, []) for item in items)
+
+
+# A song is a list of symbols: an item tuple, ('loop', count, body) or ('call', phrase index).
+# In the compiler the delay of an item counts in units, set by ('u', unit ms, 0) items
+def symbol_size(symbol, phrases):
+    if symbol[0] == 'loop':
+        return 3 + sum(symbol_size(s, phrases) for s in symbol[2])
+    if symbol[0] == 'call':
+        return 2
+    kind, value, delay = symbol
+    if kind == 'u':
+        return 1 + len(varint(value))
+    return (3 if kind == 'p' else 1) + len(varint(delay))
+
+
+def best_unit(items):
+    # The delay unit that saves the most bytes, a delay it does not divide switches to 1ms and back
+    def saving(unit):
+        if unit == 1:
+            return 0
+        total = -symbol_size(('u', unit, 0), [])
+        for _, _, delay in items:
+            if delay % unit:
+                total -= symbol_size(('u', 1, 0), []) + symbol_size(('u', unit, 0), [])
+            else:
+                total += len(varint(delay)) - len(varint(delay // unit))
+        return total
+
+    longest = max((delay for _, _, delay in items), default=1)
+    # on a tie the larger unit, its delays read as note lengths
+    return max(range(1, longest + 1), key=lambda unit: (saving(unit), unit))
+
+
+def to_units(items, unit: int):
+    if unit == 1:
+        return [tuple(item) for item in items]
+    symbols = [('u', unit, 0)]
+    for kind, value, delay in items:
+        if delay % unit:
+            symbols += [('u', 1, 0), (kind, value, delay), ('u', unit, 0)]
+        else:
+            symbols.append((kind, value, delay // unit))
+    # nothing plays after a trailing switch back
+    return symbols[:-1] if symbols[-1][0] == 'u' else symbols
+
+
+def sequence_size(sequence, phrases):
+    return sum(symbol_size(symbol, phrases) for symbol in sequence)
+
+
+def nesting(sequence, phrases):
+    # (loop depth, call depth) the interpreter needs for this sequence
+    loops = calls = 0
+    for symbol in sequence:
+        if symbol[0] == 'loop':
+            inner_loops, inner_calls = nesting(symbol[2], phrases)
+            loops, calls = max(loops, inner_loops + 1), max(calls, inner_calls)
+        elif symbol[0] == 'call':
+            inner_loops, inner_calls = nesting(phrases[symbol[1]], phrases)
+            loops, calls = max(loops, inner_loops), max(calls, inner_calls + 1)
+    return loops, calls
+
+
+def loop_passes(sequence, phrases):
+    # SONG_OP_END_LOOP passes the interpreter takes playing this sequence
+    total = 0
+    for symbol in sequence:
+        if symbol[0] == 'loop':
+            total += symbol[1] * (1 + loop_passes(symbol[2], phrases))
+        elif symbol[0] == 'call':
+            total += loop_passes(phrases[symbol[1]], phrases)
+    return total
+
+
+def fits(main, phrases):
+    loops, calls = nesting(main, phrases)
+    return loops <= SONG_LOOP_DEPTH and calls <= SONG_CALL_DEPTH
+
+
+def loop_candidates(sequences, phrases):
+    # Back to back repeats of a run of symbols, each as (saving, sequence, start, length, count)
+    for index, sequence in enumerate(sequences):
+        n = len(sequence)
+        for start in range(n):
+            for length in range(1, min((n - start) // 2, MAX_REPEAT_SYMBOLS) + 1):
+                body = sequence[start:start + length]
+                count = 1
+                while (count < MAX_LOOP_COUNT and
+                       sequence[start + count * length:start + (count + 1) * length] == body):
+                    count += 1
+                if count > 1:
+                    saving = (count - 1) * sequence_size(body, phrases) - 3
+                    if saving > 0:
+                        yield saving, ('loop', index, start, length, count)
+
+
+def phrase_candidates(sequences, phrases):
+    # Runs of symbols found more than once anywhere in the song, non overlapping
+    occurrences = {}
+    for index, sequence in enumerate(sequences):
+        n = len(sequence)
+        for length in range(2, min(n // 2, MAX_REPEAT_SYMBOLS) + 1):
+            for start in range(n - length + 1):
+                occurrences.setdefault(tuple(sequence[start:start + length]), []).append((index, start))
+
+    for body, places in occurrences.items():
+        if len(places) < 2:
+            continue
+        used, last = [], {}
+        for index, start in places:
+            if start >= last.get(index, 0):
+                used.append((index, start))
+                last[index] = start + len(body)
+        size = sequence_size(body, phrases)
+        # every use becomes a 2 byte CALL, the body is stored once with a RETURN
+        saving = len(used) * size - 2 * len(used) - size - 1
+        if len(used) > 1 and saving > 0:
+            yield saving, ('phrase', body, used)
+
+
+def apply_candidate(sequences, phrases, candidate):
+    sequences = [list(sequence) for sequence in sequences]
+    phrases = sequences[1:]
+    if candidate[0] == 'loop':
+        _, index, start, length, count = candidate
+        body = tuple(sequences[index][start:start + length])
+        sequences[index][start:start + length * count] = [('loop', count, body)]
+    else:
+        _, body, used = candidate
+        call = ('call', len(phrases))
+        phrases.append(list(body))
+        sequences.append(phrases[-1])
+        # replace from the back so earlier starts stay valid
+        for index, start in sorted(used, reverse=True):
+            sequences[index][start:start + len(body)] = [call]
+    return sequences, phrases
+
+
+def inline_single_calls(main, phrases):
+    # A phrase called from one place only costs a CALL and a RETURN, put it back
+    while True:
+        counts = [0] * len(phrases)
+
+        def count_calls(sequence):
+            for symbol in sequence:
+                if symbol[0] == 'call':
+                    counts[symbol[1]] += 1
+                elif symbol[0] == 'loop':
+                    count_calls(symbol[2])
+
+        count_calls(main)
+        for body in phrases:
+            count_calls(body)
+        single = next((i for i, count in enumerate(counts) if count < 2), None)
+        if single is None:
+            return main, phrases
+
+        body = phrases[single]
+
+        def replace(sequence):
+            result = []
+            for symbol in sequence:
+                if symbol == ('call', single):
+                    result.extend(replace(body))
+                elif symbol[0] == 'call':
+                    result.append(('call', symbol[1] - (symbol[1] > single)))
+                elif symbol[0] == 'loop':
+                    result.append(('loop', symbol[1], tuple(replace(symbol[2]))))
+                else:
+                    result.append(symbol)
+            return result
+
+        phrases = [replace(phrase) for i, phrase in enumerate(phrases) if i != single]
+        main = replace(main)
+
+
+def compress(items):
+    """
+    Greedy grammar compression: repeatedly takes the loop or phrase that saves the
+    most bytes, until nothing saves anything. Sequences are the main song and every
+    phrase body, so phrases can call phrases.
+    """
+    main, phrases = to_units(items, best_unit(items)), []
+    while True:
+        sequences = [main] + phrases
+        candidates = sorted(list(loop_candidates(sequences, phrases)) + list(phrase_candidates(sequences, phrases)),
+                            key=lambda candidate: -candidate[0])
+        for _, candidate in candidates:
+            new_sequences, new_phrases = apply_candidate(sequences, phrases, candidate)
+            if fits(new_sequences[0], new_phrases):
+                main, phrases = new_sequences[0], new_phrases
+                break
+        else:
+            return inline_single_calls(main, phrases)
+
+
+def emit(sequence, addresses):
+    code = bytearray()
+    for symbol in sequence:
+        if symbol[0] == 'loop':
+            code += bytes([OP_LOOP, symbol[1]]) + emit(symbol[2], addresses) + bytes([OP_END_LOOP])
+        elif symbol[0] == 'call':
+            code += bytes([OP_CALL, addresses[symbol[1]]])
+        else:
+            kind, value, delay = symbol
+            if kind == 'u':
+                code += bytes([OP_UNIT]) + varint(value)
+                continue
+            if kind == 'n':
+                code.append(value)
+            elif kind == 'p':
+                code += bytes([OP_PULSE, value & 0xFF, value >> 8])
+            else:
+                code.append(OP_REST)
+            code += varint(delay)
+    return bytes(code)
+
+
+def assemble(main, phrases):
+    addresses, address = [], sequence_size(main, phrases) + 1
+    for body in phrases:
+        addresses.append(address)
+        address += sequence_size(body, phrases) + 1
+    if address > SONG_CODE_SIZE:
+        raise ValueError(f"Song needs {address} bytes, the board holds {SONG_CODE_SIZE}")
+
+    code = emit(main, addresses) + bytes([OP_END])
+    for body in phrases:
+        code += emit(body, addresses) + bytes([OP_RETURN])
+    return code
+
+
+def compile_song(data):
+    # data is a list of 'play' items such as 'n48,250', returns the bytecode for utils/song.c
+    items = [parse_item(item) for item in data]
+    for kind, value, _ in items:
+        if kind == 'n' and value >= OP_PULSE:
+            raise ValueError(f"Note {value} is not a MIDI note")
+    main, phrases = compress(items)
+    if loop_passes(main, phrases) > SONG_MAX_LOOP_PASSES:
+        raise ValueError(f"Song loops more than the {SONG_MAX_LOOP_PASSES} passes the board plays")
+    code = assemble(main, phrases)
+    # the compiler is greedy and clever, make sure it still plays the same song
+    if expand(code) != items:
+        raise ValueError("Compiled song does not play back the uploaded notes, this is a song.py bug")
+    return code
+
+
+def expand(code: bytes):
+    # Runs the bytecode like SongNext() in utils/song.c, returns the items it plays
+    items, pc, unit = [], 0, 1
+    loops, calls = [], []
+    control_ops = passes = 0
+
+    def read():
+        nonlocal pc
+        if pc >= len(code):
+            return OP_END
+        pc += 1
+        return code[pc - 1]
+
+    def read_varint():
+        value = 0
+        for shift in (0, 7, 14):
+            byte = read()
+            value |= (byte & 0x7F) << shift
+            if not byte & 0x80:
+                break
+        return value
+
+    while True:
+        op = read()
+        if op < OP_PULSE:
+            items.append(('n', op, read_varint() * unit))
+            control_ops = 0
+            continue
+        control_ops += 1
+        if control_ops > SONG_MAX_CONTROL_OPS:
+            return items
+        if op == OP_PULSE:
+            value = read() | read() << 8
+            items.append(('p', value, read_varint() * unit))
+            control_ops = 0
+        elif op == OP_REST:
+            items.append(('r', 0, read_varint() * unit))
+            control_ops = 0
+        elif op == OP_UNIT:
+            unit = read_varint()
+        elif op == OP_LOOP:
+            count = read()
+            if count == 0 or len(loops) >= SONG_LOOP_DEPTH:
+                return items
+            loops.append([pc, count])
+        elif op == OP_END_LOOP and loops:
+            passes += 1
+            if passes > SONG_MAX_LOOP_PASSES:
+                return items
+            loops[-1][1] -= 1
+            if loops[-1][1] > 0:
+                pc = loops[-1][0]
+            else:
+                loops.pop()
+        elif op == OP_CALL and len(calls) < SONG_CALL_DEPTH:
+            address = read()
+            calls.append(pc)
+            pc = address
+        elif op == OP_RETURN and calls:
+            pc = calls.pop()
+        else:
+            return items
+
+
+def upload_lines(code: bytes):
+    # 'play' commands that load the bytecode, the first one announces its size
+    lines = [f'play code {len(code)}\r']
+    for i in range(0, len(code), UPLOAD_BATCH):
+        lines.append('play ' + code[i:i + UPLOAD_BATCH].hex().upper() + '\r')
+    return lines
+
+
+def flat_upload_size(data, batch_size: int = 3):
+    # characters start.py used to send, 'play <count>' and then batch_size items per line
+    lines = [f'play {len(data)}\r'] + ['play ' + ' '.join(data[i:i + batch_size]) + '\r'
+                                       for i in range(0, len(data), batch_size)]
+    return sum(len(line) for line in lines)
+
+
+def disassemble(code: bytes):
+    # One line per opcode, for looking at what the compiler found. Delays are
+    # shown as stored, in units of the last 'unit' line
+    lines, pc, depth = [], 0, 0
+    while pc < len(code):
+        # main ends with END, every phrase after it with RETURN
+        if pc > 0 and code[pc - 1] in (OP_END, OP_RETURN):
+            lines.append(f'{pc:3d}: phrase')
+            depth = 1
+        op, start = code[pc], pc
+        pc += 1
+
+        def delay():
+            nonlocal pc
+            value, shift = 0, 0
+            while True:
+                byte = code[pc]
+                pc += 1
+                value |= (byte & 0x7F) << shift
+                shift += 7
+                if not byte & 0x80:
+                    return value
+
+        indent = '  ' * depth
+        if op < OP_PULSE:
+            text = f'n{op},{delay()}'
+        elif op == OP_PULSE:
+            value = code[pc] | code[pc + 1] << 8
+            pc += 2
+            text = f'{value},{delay()}'
+        elif op == OP_REST:
+            text = f'r,{delay()}'
+        elif op == OP_UNIT:
+            text = f'unit {delay()}ms'
+        elif op == OP_LOOP:
+            text = f'loop {code[pc]}'
+            pc += 1
+            depth += 1
+        elif op == OP_END_LOOP:
+            depth -= 1
+            indent = '  ' * depth
+            text = 'end loop'
+        elif op == OP_CALL:
+            text = f'call {code[pc]}'
+            pc += 1
+        elif op == OP_RETURN:
+            text = 'return'
+        else:
+            text = 'end'
+        lines.append(f'{start:3d}: {indent}{text}')
+    return lines
+
+
+def random_song(rng: random.Random):
+    # A few motifs of notes, pulses and rests strung together, so the compiler finds loops and phrases
+    def item():
+        kind = rng.choice('nnnnpr')
+        delay = rng.choice([60, 120, 250, 250, 500, rng.randint(1, 3000)])
+        if kind == 'n':
+            return f'n{rng.randint(40, 80)},{delay}'
+        if kind == 'p':
+            return f'{rng.randint(500, 2400)},{delay}'
+        return f'r,{delay}'
+
+    motifs = [[item() for _ in range(rng.randint(1, 8))] for _ in range(rng.randint(1, 5))]
+    data = []
+    for _ in range(rng.randint(1, 8)):
+        data += rng.choice(motifs) * rng.choice([1, 1, 2, 3, 8])
+    return data
+
+
+def check_interpreter(interpreter: str, count: int = 150, seed: int = 1):
+    """
+    Runs bytecode through utils/song.c built natively (bench/song_check.c) and compares
+    every event with expand(): count random songs, plus code that only the caps end.
+    Returns the number of mismatches.
+    """
+    import subprocess
+
+    rng = random.Random(seed)
+    cases = []
+    while len(cases) < count:
+        try:
+            cases.append(compile_song(random_song(rng)))
+        except ValueError:
+            continue    # too big for the board, another one
+    # loops with nothing to play, and 255^4 passes of a 0ms rest
+    cases.append(bytes([OP_LOOP, 255] * 4 + [OP_END_LOOP] * 4 + [60, 1]))
+    cases.append(bytes([OP_LOOP, 255] * 4 + [OP_REST, 0] + [OP_END_LOOP] * 4 + [60, 1]))
+
+    names = {1: 'n', 2: 'p', 3: 'r'}
+    failed = 0
+    for i, code in enumerate(cases):
+        result = subprocess.run([interpreter], input=code.hex().upper(), capture_output=True, text=True, check=True)
+        played = [(names[int(kind)], int(value), int(delay))
+                  for kind, value, delay in (line.split() for line in result.stdout.splitlines())]
+        if played != expand(code):
+            failed += 1
+            print(f"\033[91mSong {i} plays differently in utils/song.c: {code.hex().upper()}\033[0m")
+    print(f"{len(cases) - failed}/{len(cases)} songs play the same in utils/song.c and song.py")
+    return failed
+
+
+if __name__ == "__main__":
+    # Usage: python song.py midi/HappyBirthday.mid [...] [--list]
+    #        python song.py --check build/bench/song_check, see make song-check
+    if '--check' in sys.argv:
+        sys.exit(1 if check_interpreter(sys.argv[sys.argv.index('--check') + 1]) else 0)
+
+    from roll import MidiFile
+    from start import prepare_song
+
+    for path in [arg for arg in sys.argv[1:] if not arg.startswith('--')]:
+        data = prepare_song(MidiFile(path))
+        code = compile_song(data)
+        flat, upload = flat_size([parse_item(item) for item in data]), sum(len(line) for line in upload_lines(code))
+        buffer = NOTE_BUFFER_BYTES_PER_NOTE * len(data)
+        # loops and phrases only account for the first ratio, the rest is the 1 byte note and the varint delay
+        print(f"\033[1m{path}\033[0m: {len(data)} notes, {len(code)} bytes of code, "
+              f"repeats {flat} -> {len(code)} bytes ({flat / len(code):.1f}x over flat bytecode), "
+              f"old NoteBuffer {buffer} bytes ({buffer / len(code):.1f}x), "
+              f"upload {flat_upload_size(data)} -> {upload} characters")
+        if '--list' in sys.argv:
+            print('\n'.join(disassemble(code)))
@@ -1,4 +1,5 @@
 import os
+import sys
 import time
 
 import matplotlib.pyplot as plt
@@ -6,10 +7,19 @@ import numpy as np
 import serial
 from scipy.interpolate import interp1d
 
+from autotune import auto_tune
+from calibrate import load_pitch_model, read_groups
+from capture import CapturePort
+from live import run_live
+from melody import extract_melody
+from planner import plan, tempo_factor, warn_tempo
 from roll import MidiFile
+from song import compile_song, upload_lines
 
 PITCH_PWM_DIFF_THRESHOLD = 100
 SERIAL_PORT = '/dev/cu.usbserial-120'
+# RTS/CTS wired to RD0/RD1, must match UART_FLOW_CONTROL in utils/config.h
+UART_FLOW_CONTROL = False
 
 NOTE_TO_PWM = {
     46: 1133,
@@ -32,31 +42,40 @@ ser = serial.Serial(
     parity=serial.PARITY_NONE,
     stopbits=serial.STOPBITS_ONE,
     bytesize=serial.EIGHTBITS,
+    rtscts=UART_FLOW_CONTROL,
     timeout=1             # Optional: timeout in seconds
 )
 
 prev_pitch_pwm = None
 
 
-def uart_get():
+def open_serial(port: str):
+    # Same settings as ser, for talking to more than one board
+    return serial.Serial(port=port, baudrate=ser.baudrate, parity=ser.parity, stopbits=ser.stopbits,
+                         bytesize=ser.bytesize, rtscts=ser.rtscts, timeout=ser.timeout)
+
+
+def uart_get(port=None):
+    port = port or ser
     ret_str = ''
     while not ret_str.endswith('<end>'):
         try:
-            ret_str += ser.read(1).decode('utf-8', errors='replace')
+            ret_str += port.read(1).decode('utf-8', errors='replace')
         except UnicodeDecodeError:
             ret_str += '<?>'  # Replace invalid bytes with a placeholder
     return ret_str
 
 
-def uart_send(data: str, debug=False):
+def uart_send(data: str, debug=False, port=None):
+    port = port or ser
     if not debug:
-        ser.write(data.encode('utf-8'))
+        port.write(data.encode('utf-8'))
 
     print("\033[2m UART sent:", data, "\033[0m")
 
     response = '\033[2mUART DEBUG RESPONSE\033[0m'
     if not debug:
-        response = uart_get()
+        response = uart_get(port)
         print("\033[2m UART received:", response, "\033[0m")
 
     return response
@@ -96,27 +115,7 @@ def set_pitch_pwm(new_pwm=None, debug=False):
 
 
 def tune_result(data_csv: str = 'pwm_freq_data.csv', save_file: str | None = None):
-    # Read data from csv file
-    with open(data_csv, 'r', encoding='utf-8') as f:
-        # Parse each line into tuples of (pwm, freq)
-        lines = []
-        current_line = []
-        prev_pwm = float('inf')
-
-        for line in f:
-            pwm, freq = map(float, line.strip().split(','))
-
-            # Start a new line when PWM decreases
-            if pwm < prev_pwm and current_line:
-                lines.append(current_line)
-                current_line = []
-
-            current_line.append((pwm, freq))
-            prev_pwm = pwm
-
-        # Add the last line if it's not empty
-        if current_line:
-            lines.append(current_line)
+    lines = read_groups(data_csv)
 
     # Create figure with 2 subplots side by side
     fig, (ax1, ax2) = plt.subplots(1, 2, figsize=(20, 6))
@@ -205,7 +204,14 @@ def tune(debug=False):
                 pwm = set_pitch_pwm(debug=debug)
 
         elif tune_mode == 2:  # tune automatically
+            directory = input("Enter capture directory (empty to record a new sweep): ")
             print("Tuning automatically...")
+            if directory:
+                table = auto_tune(directory)
+            else:
+                table = auto_tune(time.strftime('captures/%Y%m%d_%H%M%S'), uart_send=uart_send, debug=debug)
+            if table:
+                print("NOTE_TO_PWM =", table)
             print("Tuning finished")
         else:
             print("Invalid mode")
@@ -274,47 +280,55 @@ def test_midi(debug=False):
                 print("Invalid result")
 
 
+def prepare_song(midi_file, tracks=None, channels=None, transpose=None):
+    # transpose fixes the key, ensemble.py passes one for all boards so the parts stay in tune
+    pitch_model = load_pitch_model(NOTE_TO_PWM)
+    notes, report = extract_melody(midi_file, tracks=tracks, channels=channels)
+    print(f"Melody: {report}")
+
+    song_plan = plan(notes, pitch_model.pwm_of, transpose)
+    if song_plan:
+        notes = song_plan.notes
+        print(f"Plan: {song_plan}")
+        warn_tempo(song_plan.tempo_factor)
+    else:
+        # Nothing fits as a whole, fall back to folding each note into range
+        notes, report = extract_melody(midi_file, playable=pitch_model.playable_notes(),
+                                       tracks=tracks, channels=channels)
+        print(f"\033[93mNo transposition fits the calibrated range, clamping: {report}\033[0m")
+        for tick, original, clamped in report.clamped_notes:
+            print(f"\033[93m Note {original} at tick {tick} clamped to {clamped}\033[0m")
+        factor = tempo_factor(notes, pitch_model.pwm_of)
+        print(f"Max tempo x{factor:.2f}")
+        warn_tempo(factor)
+
+    # The firmware looks notes up in utils/note_table.h, regenerate it with calibrate.py after tuning
+    return [f'n{note},{delay}' for note, delay in notes]
+
+
+def upload_song(data, debug=False, port=None):
+    # Goes up as bytecode, repeated phrases are sent once, see song.py
+    code = compile_song(data)
+    # Without the echo the board sends only its replies, half the bytes of every line
+    uart_send('echo off\r', debug=debug, port=port)
+    try:
+        for line in upload_lines(code):
+            uart_send(line, debug=debug, port=port)
+    finally:
+        uart_send('echo on\r', debug=debug, port=port)
+
+
 def play_midi(debug=False):
-    data = []
-    notes = []
-    delays = []
-    sum = 0
-    flag = False
     midi_file = MidiFile(select_midi_file())
     # midi_file.draw_roll()
     # input("Press Enter to continue...")
+    data = prepare_song(midi_file)
+
     try:
-        for i, track in enumerate(midi_file.tracks):
-            for message in track:
-                if message.type in ['note_on', 'note_off']:
-                    print(message)
-                    sum += message.time
-
-                    if message.type == 'note_on':
-                        flag = not flag
-                        if not flag:
-                            continue
-                        notes.append(message.note)
-                        delays.append(int(sum*0.5))
-                        sum = 0
-
-    except Exception as e:
-        print("Error:", e)
-
-    delays = delays[1:] + [delays[0]]
-    data = [f'{NOTE_TO_PWM[note]},{delay}' for note, delay in zip(notes, delays)]
-
-    idx = 0
-    BATCH_SIZE = 3
-    uart_send(f'play {len(data)}\r', debug=debug)
-    while idx + BATCH_SIZE < len(data):
-        batch = data[idx:idx+BATCH_SIZE]
-        uart_send('play ' + ' '.join(batch) + '\r', debug=debug)
-        # input("Press Enter to continue...")
-        idx += BATCH_SIZE
-
-    batch = data[idx:]
-    uart_send('play ' + ' '.join(batch) + '\r', debug=debug)
+        upload_song(data, debug=debug)
+    except ValueError as e:
+        print(f"\033[91m{e}\033[0m")
+        return
     response = uart_send('play start\r', debug=debug)
     while '<done>' not in response:
         response = uart_get()
@@ -349,6 +363,7 @@ def command_mode(debug=False):
 
 
 if __name__ == "__main__":
+    # Usage: python start.py [--capture session.ucap], replay a capture with capture.py
     debug_enable = False
     try:
         # Open the serial port if it's not already open
@@ -356,6 +371,10 @@ if __name__ == "__main__":
             ser.port = SERIAL_PORT
             ser.open()
         print("Connected to serial port " + ser.port)
+        if '--capture' in sys.argv:
+            capture_file = sys.argv[sys.argv.index('--capture') + 1]
+            ser = CapturePort(ser, capture_file)
+            print("Capturing UART traffic to " + capture_file)
     except serial.serialutil.SerialException as e:
         debug_enable = True
         print("Unable to open serial port, entering debug mode")
@@ -366,11 +385,11 @@ if __name__ == "__main__":
                 print("\n[Debug mode]")
                 mode = int(
                     input(
-                        "Enter mode: 1)Tune 2)Play 3)Tune Result 4)Exit Debug 5)Pick 6)Test MIDI 7)Reset 8)Status: "))
+                        "Enter mode: 1)Tune 2)Play 3)Tune Result 4)Exit Debug 5)Pick 6)Test MIDI 7)Reset 8)Status 9)Live: "))
             else:
                 mode = int(
                     input(
-                        "Enter mode: 1)Tune 2)Play 3)Tune Result 4)Debug 5)Pick 6)Test MIDI 7)Reset 8)Status: "))
+                        "Enter mode: 1)Tune 2)Play 3)Tune Result 4)Debug 5)Pick 6)Test MIDI 7)Reset 8)Status 9)Live: "))
 
             if mode == 1:
                 tune(debug=debug_enable)
@@ -391,10 +410,17 @@ if __name__ == "__main__":
                 uart_send('reset\r', debug=debug_enable)
             elif mode == 8:
                 uart_send('status\r', debug=debug_enable)
+            elif mode == 9:
+                if debug_enable:
+                    print("\033[91mLive mode needs the serial port\033[0m")
+                    continue
+                source = input("Enter MIDI input port or .mid file: ")
+                run_live(source, ser)
             else:
                 print("Invalid mode")
                 continue
     except KeyboardInterrupt:
         print("\n\033[91mExiting...\033[0m")
-
-    ser.close()
+    finally:
+        # also ends a --capture file cleanly when something else stopped the session
+        ser.close()
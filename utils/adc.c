@@ -2,6 +2,9 @@
 #include "settings.h"
 #include "config.h"
 
+volatile unsigned char adc_result = 0;
+volatile unsigned char adc_result_ready = 0;
+
 void AdcInitialize(IntPriority int_priority){
     TRISAbits.RA0 = 1; // AN0 as input
 
@@ -29,3 +32,18 @@ void AdcEnableInterrupt(IntPriority priority){
     PIR1bits.ADIF = 0;
     IPR1bits.ADIP = priority;
 }
+
+void AdcStoreResult(void){
+    // called from the ADC interrupt, 8-bit result is enough when left justified
+    adc_result = AdcGetResultHigh();
+    adc_result_ready = 1;
+}
+
+unsigned char AdcGetResult(void){
+    adc_result_ready = 0;
+    return adc_result;
+}
+
+unsigned char AdcResultReady(void){
+    return adc_result_ready;
+}
@@ -29,5 +29,8 @@
 
 void AdcInitialize(IntPriority int_priority);
 void AdcEnableInterrupt(IntPriority);
+void AdcStoreResult(void);
+unsigned char AdcGetResult(void);
+unsigned char AdcResultReady(void);
 
 #endif
\ No newline at end of file
@@ -44,6 +44,21 @@ void PWMSetDutyCycle(double duty_cycle_us){
     CCP1CONbits.DC1B = (val & 0x03);
 }
 
+void PWMSetDutyValue(unsigned int value){
+    // value is the raw 10-bit CCPR1L:DC1B duty, e.g. from note_table.h
+    PWMDutyCycle = (double)value * Timer2GetPrescaler() / (_XTAL_FREQ / 1000000);
+    CCPR1L = (value >> 2) & 0xFF;
+    CCP1CONbits.DC1B = (value & 0x03);
+}
+
+unsigned int PWMDutyValueFromUs(unsigned int duty_cycle_us){
+    return ((unsigned long)duty_cycle_us * (_XTAL_FREQ / 1000000)) / Timer2GetPrescaler();
+}
+
+unsigned int PWMDutyValueToUs(unsigned int value){
+    return ((unsigned long)value * Timer2GetPrescaler()) / (_XTAL_FREQ / 1000000);
+}
+
 double PWMGetDutyCycle(){
     return PWMDutyCycle;
 }
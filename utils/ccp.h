@@ -10,6 +10,9 @@
 void PWMInitialize(double period_ms);
 void PWMSetPeriod(double period_ms);
 void PWMSetDutyCycle(double duty_cycle_us);
+void PWMSetDutyValue(unsigned int value);
+unsigned int PWMDutyValueFromUs(unsigned int duty_cycle_us);
+unsigned int PWMDutyValueToUs(unsigned int value);
 double PWMGetDutyCycle();
 void MotorRotateWithDelay(double target_duty_cycle);
 void MotorRotateDegree(int degree);
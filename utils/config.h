@@ -3,7 +3,20 @@
 
 #define _XTAL_FREQ 4000000 
 #define UART_BAUD_RATE 1200
+// RTS on RD0, CTS on RD1, must match UART_FLOW_CONTROL in start.py
+#define UART_FLOW_CONTROL 0
+
+// RD pins driven by the software servo engine (bit n = channel n), 0 disables it
+#define SERVO_CHANNEL_MASK 0x00
 
 #define ADC_JUSTIFICATION LEFT_JUSTIFIED
 
+// Pitch servo position feedback from a potentiometer tap on AN0
+#define SERVO_SETTLE_FEEDBACK 0
+#define SERVO_FEEDBACK_ADC_NEG_90 20    // ADRESH reading at -90 degree
+#define SERVO_FEEDBACK_ADC_POS_90 235   // ADRESH reading at +90 degree
+#define SERVO_SETTLE_TOLERANCE 3        // in ADRESH counts
+#define SERVO_SETTLE_SAMPLES 2          // consecutive readings within tolerance
+#define SERVO_SETTLE_TIMEOUT_MS 75
+
 #endif
\ No newline at end of file
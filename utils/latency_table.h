@@ -0,0 +1,34 @@
+// Generated by latency.py from the servo speed model, do not edit
+#ifndef LATENCY_TABLE_H
+#define LATENCY_TABLE_H
+
+// Estimates from the servo speed model, not measured: run python latency.py measure
+#define LATENCY_MEASURED 0
+
+// ms from the pick command until the string sounds, per stroke direction
+#define LATENCY_PICK_RISE_MS 73
+#define LATENCY_PICK_FALL_MS 73
+
+// lead of an armed start, the worst rest and note jumps or the pick, so every board in an
+// ensemble hears its first note the same time after go whatever its part and pitch position
+#define LATENCY_START_LEAD_MS 328
+
+// ms from a pitch command until the servo settles, per direction and pulse width jump
+#define LATENCY_JUMP_STEP_US 50
+#define LATENCY_JUMP_STEPS 21
+#define LatencyJumpIndex(jump_us) ((jump_us) >= LATENCY_JUMP_STEP_US * (LATENCY_JUMP_STEPS - 1) ? \
+    LATENCY_JUMP_STEPS - 1 : ((jump_us) + LATENCY_JUMP_STEP_US - 1) / LATENCY_JUMP_STEP_US)
+#define LatencyPitchUpMs(jump_us) (latency_pitch_up_ms[LatencyJumpIndex(jump_us)])
+#define LatencyPitchDownMs(jump_us) (latency_pitch_down_ms[LatencyJumpIndex(jump_us)])
+
+static const unsigned char latency_pitch_up_ms[] = {
+      5,  13,  21,  29,  37,  45,  53,  61,  69,  77,  85,
+     93, 101, 109, 117, 125, 132, 140, 148, 156, 164,
+};
+
+static const unsigned char latency_pitch_down_ms[] = {
+      5,  13,  21,  29,  37,  45,  53,  61,  69,  77,  85,
+     93, 101, 109, 117, 125, 132, 140, 148, 156, 164,
+};
+
+#endif
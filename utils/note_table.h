@@ -0,0 +1,22 @@
+// Generated by calibrate.py from NOTE_TO_PWM, do not edit
+#ifndef NOTE_TABLE_H
+#define NOTE_TABLE_H
+
+#include "config.h"
+
+#if _XTAL_FREQ != 4000000
+#error "note_table.h was generated for another oscillator, rerun calibrate.py"
+#endif
+
+#define NOTE_TABLE_FIRST 46
+#define NOTE_TABLE_LAST 60
+#define NoteInTable(note) (NOTE_TABLE_FIRST <= (note) && (note) <= NOTE_TABLE_LAST)
+#define NoteToDutyValue(note) (note_table[(note) - NOTE_TABLE_FIRST])
+
+// CCPR1L:DC1B duty value of each MIDI note, Timer2 prescaler 16
+static const unsigned int note_table[] = {
+     283,  288,  293,  298,  303,  306,  309,  311,
+     314,  316,  320,  324,  326,  330,  337,
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "servo.h"
+#include "ccp.h"
+#include "config.h"
+
+unsigned int servo_pulse_us[SERVO_CHANNELS] = {0};
+int servo_degree[SERVO_CHANNELS] = {0};
+volatile unsigned char servo_dirty = 0;
+
+/**
+ * One frame is a list of edges sorted by time. Edge k < count - 1 clears
+ * servo_edge_mask[k], the last edge starts the next frame and raises every
+ * active pin. servo_edge_ticks[k] is the Timer3 time from the previous edge.
+ */
+unsigned int servo_edge_ticks[SERVO_CHANNELS + 1];
+unsigned char servo_edge_mask[SERVO_CHANNELS + 1];
+unsigned char servo_edge_count = 0;
+unsigned char servo_next_edge = 0;
+unsigned char servo_active_mask = 0;
+
+void ServoBuildSchedule(void){
+    unsigned char order[SERVO_CHANNELS];
+    unsigned char count = 0;
+
+    // insertion sort of the active channels by pulse width
+    for(unsigned char channel = 0; channel < SERVO_CHANNELS; channel++){
+        if(!((SERVO_CHANNEL_MASK >> channel) & 0x01) || servo_pulse_us[channel] == 0) continue;
+        unsigned char i = count++;
+        while(i > 0 && servo_pulse_us[order[i - 1]] > servo_pulse_us[channel]){
+            order[i] = order[i - 1];
+            i--;
+        }
+        order[i] = channel;
+    }
+
+    unsigned char edges = 0;
+    unsigned int prev_us = 0;
+    servo_active_mask = 0;
+    for(unsigned char i = 0; i < count; i++){
+        unsigned char bit = 1 << order[i];
+        unsigned int pulse_us = servo_pulse_us[order[i]];
+        servo_active_mask |= bit;
+        if(edges > 0 && pulse_us == prev_us){
+            // same width, one edge clears both
+            servo_edge_mask[edges - 1] |= bit;
+            continue;
+        }
+        servo_edge_ticks[edges] = ServoUsToTicks(pulse_us - prev_us);
+        servo_edge_mask[edges] = bit;
+        edges++;
+        prev_us = pulse_us;
+    }
+    servo_edge_ticks[edges] = ServoUsToTicks(SERVO_FRAME_US - prev_us);
+    servo_edge_mask[edges] = 0;
+    servo_edge_count = edges + 1;
+    servo_dirty = 0;
+}
+
+void ServoInitialize(IntPriority priority){
+    SERVO_TRIS &= ~SERVO_CHANNEL_MASK;
+    SERVO_LAT &= ~SERVO_CHANNEL_MASK;
+    ServoBuildSchedule();
+    servo_next_edge = servo_edge_count - 1;
+
+    // Timer3 at Fosc/4 without prescaler, overflow interrupt marks each edge
+    T3CONbits.RD16 = 1;
+    T3CONbits.T3CKPS = 0b00;
+    T3CONbits.TMR3CS = 0;
+    TMR3 = 0 - servo_edge_ticks[servo_next_edge];
+
+    PIR2bits.TMR3IF = 0;
+    if(priority != INTERRUPT_NONE){
+        IPR2bits.TMR3IP = priority;
+        PIE2bits.TMR3IE = 1;
+    }
+    T3CONbits.TMR3ON = 1;
+}
+
+void ServoSetPulseWidth(unsigned char channel, unsigned int pulse_us){
+    if(channel >= SERVO_CHANNELS) return;
+    if(pulse_us < MOTOR_NEG_90_DEG_US) pulse_us = MOTOR_NEG_90_DEG_US;
+    if(pulse_us > MOTOR_POS_90_DEG_US) pulse_us = MOTOR_POS_90_DEG_US;
+    // the ISR must not read a half written pulse width
+    unsigned char enabled = PIE2bits.TMR3IE;
+    PIE2bits.TMR3IE = 0;
+    servo_pulse_us[channel] = pulse_us;
+    // picked up after the last falling edge of the current frame
+    servo_dirty = 1;
+    PIE2bits.TMR3IE = enabled;
+}
+
+unsigned int ServoGetPulseWidth(unsigned char channel){
+    if(channel >= SERVO_CHANNELS) return 0;
+    return servo_pulse_us[channel];
+}
+
+void ServoRotateDegree(unsigned char channel, int degree){
+    if(channel >= SERVO_CHANNELS) return;
+    servo_degree[channel] = degree;
+    long pulse_us = (long)(MOTOR_POS_90_DEG_US - MOTOR_NEG_90_DEG_US) * (degree + 90) / 180 + MOTOR_NEG_90_DEG_US;
+    ServoSetPulseWidth(channel, pulse_us);
+}
+
+int ServoGetRotateDegree(unsigned char channel){
+    if(channel >= SERVO_CHANNELS) return 0;
+    return servo_degree[channel];
+}
+
+void ServoInterruptHandler(void){
+    // ticks since the overflow that raised this interrupt at which the next edge is due
+    unsigned int target = 0;
+    while(1){
+        unsigned char edge = servo_next_edge;
+        if(edge == servo_edge_count - 1){
+            SERVO_LAT |= servo_active_mask;
+        } else {
+            SERVO_LAT &= ~servo_edge_mask[edge];
+        }
+
+        unsigned char next = (edge + 1 == servo_edge_count) ? 0 : edge + 1;
+        unsigned int delta = servo_edge_ticks[next];
+        if(next == servo_edge_count - 1 && servo_dirty){
+            // all pins are low until the frame ends, safe to swap the schedule
+            ServoBuildSchedule();
+            next = servo_edge_count - 1;
+        }
+        servo_next_edge = next;
+        target += delta;
+
+        // measured from now, a schedule rebuild or another HighIsr source may have used up the gap,
+        // and TMR3 must still be short of target below or it wraps and loses a whole frame
+        if(target > TMR3 + ServoUsToTicks(SERVO_MIN_GAP_US)) break;
+        while(TMR3 < target);
+    }
+    TMR3 -= target - SERVO_RELOAD_FIX_TICKS;
+}
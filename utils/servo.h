@@ -0,0 +1,33 @@
+#ifndef SERVO_H
+#define SERVO_H
+
+#include "settings.h"
+#include "config.h"
+
+// Software servo PWM on PORTD, for servos beyond the two CCP outputs
+#define SERVO_CHANNELS 8
+#define SERVO_FRAME_US 20000
+#define SERVO_LAT LATD
+#define SERVO_TRIS TRISD
+// edges closer than this are timed by spinning in the ISR instead of another interrupt,
+// at 1 Tcy per us it has to cover the HighIsr entry, exit and the edge bookkeeping
+#define SERVO_MIN_GAP_US 150
+// Timer3 ticks lost while TMR3 is rewritten, tune with a scope
+#define SERVO_RELOAD_FIX_TICKS 4
+
+#if UART_FLOW_CONTROL && (SERVO_CHANNEL_MASK & 0x03)
+#error "RD0/RD1 are used for RTS/CTS, remove them from SERVO_CHANNEL_MASK"
+#endif
+
+#define ServoIF (PIR2bits.TMR3IF && PIE2bits.TMR3IE)
+#define ServoIntDone() PIR2bits.TMR3IF = 0
+#define ServoUsToTicks(us) ((unsigned int)((unsigned long)(us) * (_XTAL_FREQ / 1000000) / 4))
+
+void ServoInitialize(IntPriority priority);
+void ServoSetPulseWidth(unsigned char channel, unsigned int pulse_us);
+unsigned int ServoGetPulseWidth(unsigned char channel);
+void ServoRotateDegree(unsigned char channel, int degree);
+int ServoGetRotateDegree(unsigned char channel);
+void ServoInterruptHandler(void);
+
+#endif
@@ -62,6 +62,7 @@
 #include "ccp.h"
 #include "uart.h"
 #include "timer.h"
+#include "servo.h"
 void ComponentInitialize(SystemComponents components, IntConfig *int_config, ComponentConfig component_config) {
     if(int_config) InterruptInitialize();
     // Oscillator should always be initialized first if selected
@@ -90,6 +91,10 @@ void ComponentInitialize(SystemComponents components, IntConfig *int_config, Com
         if(int_config) Timer2Initialize(int_config->timer2, component_config.prescaler2, component_config.postscaler2, component_config.timer_period_ms);
         else Timer2Initialize(INTERRUPT_NONE, component_config.prescaler2, component_config.postscaler2, component_config.timer_period_ms);
     }
+    if (components & COMPONENT_SERVO) {
+        if(int_config) ServoInitialize(int_config->servo);
+        else ServoInitialize(INTERRUPT_NONE);
+    }
     if (components & COMPONENT_UART) {
         if(int_config) UartInitialize(int_config->uart_tx, int_config->uart_rx);
         else UartInitialize(INTERRUPT_NONE, INTERRUPT_NONE);
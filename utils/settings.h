@@ -41,6 +41,7 @@ typedef struct {
     IntPriority timer2;
     IntPriority uart_tx;
     IntPriority uart_rx;
+    IntPriority servo;
 } IntConfig;
 
 typedef struct {
@@ -72,7 +73,8 @@ typedef enum {
     COMPONENT_UART        = 0x10,
     COMPONENT_TIMER1      = 0x20,
     COMPONENT_TIMER2      = 0x40,
-    COMPONENT_ALL         = 0x7F
+    COMPONENT_SERVO       = 0x80,
+    COMPONENT_ALL         = 0xFF
 } SystemComponents;
 
 typedef enum {
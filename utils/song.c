@@ -0,0 +1,151 @@
+#include "song.h"
+
+unsigned char song_code[SONG_CODE_SIZE];
+unsigned int song_length = 0;
+unsigned int song_pc = 0;
+unsigned int song_unit = 1;
+
+// SONG_OP_LOOP pushes the address of its body and the plays left, SONG_OP_CALL its return address
+unsigned int song_loop_start[SONG_LOOP_DEPTH];
+unsigned char song_loop_left[SONG_LOOP_DEPTH];
+unsigned char song_loop_depth = 0;
+unsigned int song_call_return[SONG_CALL_DEPTH];
+unsigned char song_call_depth = 0;
+unsigned int song_loop_passes = 0;
+
+void SongClear(void){
+    song_length = 0;
+    SongRewind();
+}
+
+unsigned int SongLength(void){
+    return song_length;
+}
+
+unsigned char SongAppend(unsigned char byte){
+    // returns 0 when the song is full
+    if(song_length >= SONG_CODE_SIZE) return 0;
+    song_code[song_length++] = byte;
+    return 1;
+}
+
+unsigned char SongVarintLength(unsigned int value){
+    unsigned char length = 1;
+    while(value >= 0x80){
+        value >>= 7;
+        length++;
+    }
+    return length;
+}
+
+void SongAppendVarint(unsigned int value){
+    while(value >= 0x80){
+        song_code[song_length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    song_code[song_length++] = value;
+}
+
+unsigned char SongAppendNote(unsigned char note, unsigned int delay_ms){
+    // all or nothing, half a note would garble everything after it
+    if(note >= SONG_OP_PULSE || song_length + 1 + SongVarintLength(delay_ms) > SONG_CODE_SIZE) return 0;
+    song_code[song_length++] = note;
+    SongAppendVarint(delay_ms);
+    return 1;
+}
+
+unsigned char SongAppendPulse(unsigned int pulse_us, unsigned int delay_ms){
+    if(song_length + 3 + SongVarintLength(delay_ms) > SONG_CODE_SIZE) return 0;
+    song_code[song_length++] = SONG_OP_PULSE;
+    song_code[song_length++] = pulse_us & 0xFF;
+    song_code[song_length++] = pulse_us >> 8;
+    SongAppendVarint(delay_ms);
+    return 1;
+}
+
+void SongRewind(void){
+    song_pc = 0;
+    song_unit = 1;
+    song_loop_depth = 0;
+    song_call_depth = 0;
+    song_loop_passes = 0;
+}
+
+unsigned char SongReadByte(void){
+    // running off the end reads as SONG_OP_END
+    if(song_pc >= song_length) return SONG_OP_END;
+    return song_code[song_pc++];
+}
+
+unsigned int SongReadVarint(void){
+    unsigned int value = 0;
+    for(unsigned char shift = 0; shift < 16; shift += 7){
+        unsigned char byte = SongReadByte();
+        value |= (unsigned int)(byte & 0x7F) << shift;
+        if(!(byte & 0x80)) break;
+    }
+    return value;
+}
+
+void SongNext(SongEvent *event){
+    // runs the control opcodes up to the next note or rest, malformed code ends the song
+    event->value = 0;
+    event->delay_ms = 0;
+    unsigned char control_ops = 0;
+    while(1){
+        unsigned char op = SongReadByte();
+        if(op < SONG_OP_PULSE){
+            event->kind = SONG_NOTE;
+            event->value = op;
+            event->delay_ms = SongReadVarint() * song_unit;
+            return;
+        }
+        if(++control_ops > SONG_MAX_CONTROL_OPS) op = SONG_OP_END;
+        switch(op){
+            case SONG_OP_PULSE:
+                event->kind = SONG_PULSE;
+                event->value = SongReadByte();
+                event->value |= (unsigned int)SongReadByte() << 8;
+                event->delay_ms = SongReadVarint() * song_unit;
+                return;
+            case SONG_OP_REST:
+                event->kind = SONG_REST;
+                event->delay_ms = SongReadVarint() * song_unit;
+                return;
+            case SONG_OP_UNIT:
+                song_unit = SongReadVarint();
+                continue;
+            case SONG_OP_LOOP:
+                op = SongReadByte();
+                if(op == 0 || song_loop_depth >= SONG_LOOP_DEPTH) break;
+                song_loop_start[song_loop_depth] = song_pc;
+                song_loop_left[song_loop_depth] = op;
+                song_loop_depth++;
+                continue;
+            case SONG_OP_END_LOOP:
+                if(song_loop_depth == 0 || ++song_loop_passes > SONG_MAX_LOOP_PASSES) break;
+                if(--song_loop_left[song_loop_depth - 1] > 0){
+                    song_pc = song_loop_start[song_loop_depth - 1];
+                } else {
+                    song_loop_depth--;
+                }
+                continue;
+            case SONG_OP_CALL:
+                op = SongReadByte();
+                if(song_call_depth >= SONG_CALL_DEPTH) break;
+                song_call_return[song_call_depth++] = song_pc;
+                song_pc = op;
+                continue;
+            case SONG_OP_RETURN:
+                if(song_call_depth == 0) break;
+                song_pc = song_call_return[--song_call_depth];
+                continue;
+            default:
+                break;
+        }
+        // SONG_OP_END, or code that cannot run
+        event->kind = SONG_DONE;
+        song_pc = song_length;
+        return;
+    }
+}
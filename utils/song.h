@@ -0,0 +1,51 @@
+#ifndef SONG_H
+#define SONG_H
+
+/**
+ * Song bytecode, compiled by song.py. Bytes 0x00-0x7F play that MIDI note,
+ * every other opcode is listed below. A delay is a varint: 7 bits per byte,
+ * low bits first, the high bit is set on every byte but the last. Delays
+ * count in units of SONG_OP_UNIT, 1ms until the song sets one. The bundled
+ * songs take 1.7-2.9x less than the old 4 byte per note NoteBuffer, of that
+ * 1.2-2.2x comes from loops and phrases over flat note opcodes.
+ */
+#define SONG_CODE_SIZE 256
+#define SONG_LOOP_DEPTH 4
+#define SONG_CALL_DEPTH 4
+// SongNext() runs inside LowIsr, these end a song whose loops would keep it there:
+// control opcodes between two events, a loop with nothing to play spins on those,
+// and SONG_OP_END_LOOP passes per song, nested loops of 0ms rests spin on these
+#define SONG_MAX_CONTROL_OPS 64
+#define SONG_MAX_LOOP_PASSES 4096
+
+#define SONG_OP_PULSE 0x80      // pulse width us (2 bytes, low first), delay
+#define SONG_OP_REST 0x81       // delay
+#define SONG_OP_LOOP 0x82       // count, plays up to the matching SONG_OP_END_LOOP count times
+#define SONG_OP_END_LOOP 0x83
+#define SONG_OP_CALL 0x84       // address of a phrase that ends with SONG_OP_RETURN
+#define SONG_OP_RETURN 0x85
+#define SONG_OP_END 0x86
+#define SONG_OP_UNIT 0x87       // ms per delay unit, a varint
+
+typedef enum {
+    SONG_DONE,
+    SONG_NOTE,      // value is a MIDI note
+    SONG_PULSE,     // value is a pulse width in us
+    SONG_REST,
+} SongEventKind;
+
+typedef struct {
+    SongEventKind kind;
+    unsigned int value;
+    unsigned int delay_ms;
+} SongEvent;
+
+void SongClear(void);
+unsigned int SongLength(void);
+unsigned char SongAppend(unsigned char byte);
+unsigned char SongAppendNote(unsigned char note, unsigned int delay_ms);
+unsigned char SongAppendPulse(unsigned int pulse_us, unsigned int delay_ms);
+void SongRewind(void);
+void SongNext(SongEvent *event);
+
+#endif
@@ -4,6 +4,11 @@
 int Timer1Prescaler = 8;
 int Timer2Prescaler = 16;
 int Timer2Postscaler = 16;
+unsigned long Timer1Millis = 0;
+unsigned int Timer1LastCount = 0;
+unsigned int Timer1Ticks = 0;
+// wraps not yet folded into Timer1Millis
+unsigned char Timer1Overflows = 0;
 
 void Timer1Initialize(IntPriority priority, int prescaler){
     T1CONbits.RD16 = 1;
@@ -26,7 +31,9 @@ void Timer1Initialize(IntPriority priority, int prescaler){
             break;
     }
     if(priority != INTERRUPT_NONE){
+        // the overflow interrupt keeps Timer1GetMillis() right across long idle gaps
         IPR1bits.TMR1IP = priority;
+        PIE1bits.TMR1IE = 1;
     }
 
     T1CONbits.TMR1ON = 1;
@@ -45,6 +52,28 @@ void Timer1StopInterrupt(void){
     PIE1bits.TMR1IE = 0;
 }
 
+void Timer1InterruptHandler(void){
+    Timer1IntDone();
+    Timer1Overflows++;
+}
+
+unsigned long Timer1GetMillis(void){
+    // TMR1 wraps every 65536 ticks (524ms at 4MHz, prescaler 8), the overflow interrupt counts
+    // the wraps between calls; one pending right now would only be counted after this returns
+    unsigned int count = TMR1;
+    if(PIR1bits.TMR1IF){
+        Timer1InterruptHandler();
+        count = TMR1;
+    }
+    unsigned int ticks_per_ms = (_XTAL_FREQ / 4000) / Timer1Prescaler;
+    unsigned long ticks = (unsigned long)Timer1Ticks + ((unsigned long)Timer1Overflows << 16) + count - Timer1LastCount;
+    Timer1Overflows = 0;
+    Timer1LastCount = count;
+    Timer1Millis += ticks / ticks_per_ms;
+    Timer1Ticks = ticks % ticks_per_ms;
+    return Timer1Millis;
+}
+
 void Timer2Initialize(IntPriority priority, int prescaler, int postscaler, double period_ms){
     Timer2Prescaler = prescaler;
     Timer2Postscaler = postscaler;
@@ -14,8 +14,11 @@ void Timer1Initialize(IntPriority priority, int prescaler);
 void Timer1StartInterrupt(double period_ms);
 void Timer1StopInterrupt(void);
 void Timer1SetPeriod(double period_ms);
+void Timer1InterruptHandler(void);
+unsigned long Timer1GetMillis(void);
 
 void Timer2Initialize(IntPriority priority, int prescaler, int postscaler, double period_ms);
 void Timer2SetPeriod(double period_ms);
+int Timer2GetPrescaler(void);
 
 #endif
\ No newline at end of file
@@ -6,6 +6,19 @@
 
 char uart_buffer[UART_BUFFER_SIZE];
 int uart_buffer_idx = 0;
+unsigned int uart_overrun_count = 0;
+unsigned int uart_dropped_count = 0;
+unsigned int uart_cts_timeout_count = 0;
+// the line lost bytes, the command handler rejects it instead of running what is left
+unsigned char uart_line_overflow = 0;
+unsigned char uart_cts_lost = 0;
+// every received byte goes back to the sender, for terminals; host tools turn it off
+unsigned char uart_echo = 1;
+// replies wait here and leave as the transmitter frees up, so LowIsr doesn't sit out
+// every byte at the baud rate while the next command is arriving
+char uart_tx_buffer[UART_TX_BUFFER_SIZE];
+unsigned char uart_tx_head = 0;
+unsigned char uart_tx_count = 0;
 
 
 void SetBaudRate(void){
@@ -30,6 +43,12 @@ void UartInitialize(IntPriority tx_priority, IntPriority rx_priority){
     TRISCbits.RC6 = 1;
     TRISCbits.RC7 = 1;
 
+#if UART_FLOW_CONTROL
+    UART_RTS_TRIS = 0;
+    UART_CTS_TRIS = 1;
+    UartRtsReady();
+#endif
+
     SetBaudRate();
 
     //   Serial enable
@@ -52,11 +71,49 @@ void UartInitialize(IntPriority tx_priority, IntPriority rx_priority){
 void UartClearBuffer(void){
     uart_buffer_idx = 0;
     uart_buffer[0] = '\0';
+    uart_line_overflow = 0;
+    UartRtsReady();
+}
+
+void UartTxPoll(void){
+    // main() and LowIsr both send, keep LowIsr out while the queue changes
+    unsigned char giel = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    while(uart_tx_count > 0 && TXSTAbits.TRMT == 1 && UartCtsClear()){
+        TXREG = uart_tx_buffer[uart_tx_head];
+        uart_tx_head = (uart_tx_head + 1) % UART_TX_BUFFER_SIZE;
+        uart_tx_count--;
+        uart_cts_lost = 0;
+    }
+    INTCONbits.GIEL = giel;
+}
+
+unsigned char UartTxPending(void){
+    return uart_tx_count;
 }
 
 void UartSendChar(char c){
-    while(TXSTAbits.TRMT == 0); // wait for previous transmission to finish
-    TXREG = c;
+    // queue full: wait for the host to accept data, but not forever once it stopped reading
+    unsigned int waited = 0;
+    UartTxPoll();
+    while(uart_tx_count >= UART_TX_BUFFER_SIZE){
+        if(!UartCtsClear()){
+            if(uart_cts_lost || waited >= UART_CTS_TIMEOUT_MS * 10){
+                if(!uart_cts_lost) uart_cts_timeout_count++;
+                uart_cts_lost = 1;
+                return;
+            }
+            __delay_us(100);
+            waited++;
+        }
+        UartTxPoll();
+    }
+    unsigned char giel = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    uart_tx_buffer[(uart_tx_head + uart_tx_count) % UART_TX_BUFFER_SIZE] = c;
+    uart_tx_count++;
+    INTCONbits.GIEL = giel;
+    UartTxPoll();
 }
 
 void UartSendString(char *str){
@@ -71,16 +128,49 @@ void UartSendInt(int num){
     UartSendString(str);
 }
 
-void UartReceiveChar(void){
+void UartSendUnsigned(unsigned int num){
+    char str[6];
+    sprintf(str, "%u", num);
+    UartSendString(str);
+}
+
+void UartSendLong(long num){
+    char str[12];
+    sprintf(str, "%ld", num);
+    UartSendString(str);
+}
+
+unsigned char UartReceiveByte(void){
     if(RCSTAbits.OERR == 1){
         // clear overrun error
+        uart_overrun_count++;
         RCSTAbits.CREN = 0;
         RCSTAbits.CREN = 1;
     }
-    char c = RCREG;
-    if(c == '\r') UartSendChar('\n');
+    return RCREG;
+}
+
+void UartBufferChar(char c){
+    // keep one byte for the terminating '\0' added by UartCopyBufferToString
+    if(uart_buffer_idx >= UART_BUFFER_SIZE - 1){
+        uart_dropped_count++;
+        uart_line_overflow = 1;
+        if(c != '\r') return;
+        // still end the line so the buffer gets cleared
+        uart_buffer_idx--;
+    }
+    if(uart_echo && c == '\r') UartSendChar('\n');
     uart_buffer[uart_buffer_idx++] = c;
-    UartSendChar(c);
+    if(uart_buffer_idx >= UART_BUFFER_SIZE - UART_RTS_MARGIN) UartRtsHold();
+    if(uart_echo) UartSendChar(c);
+}
+
+void UartSetEcho(unsigned char on){
+    uart_echo = on;
+}
+
+void UartReceiveChar(void){
+    UartBufferChar(UartReceiveByte());
 }
 
 char UartGetChar(void){
@@ -111,3 +201,19 @@ void UartCopyBufferToString(char *str) {
     }
     str[uart_buffer_idx] = '\0';
 }
+
+unsigned int UartGetOverrunCount(void){
+    return uart_overrun_count;
+}
+
+unsigned int UartGetDroppedCount(void){
+    return uart_dropped_count;
+}
+
+unsigned int UartGetCtsTimeoutCount(void){
+    return uart_cts_timeout_count;
+}
+
+unsigned char UartLineOverflowed(void){
+    return uart_line_overflow;
+}
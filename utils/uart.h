@@ -25,14 +25,46 @@
 #endif
 
 #define UART_BUFFER_SIZE 128
+// stop the host this many bytes before the buffer is full
+#define UART_RTS_MARGIN 16
+// a host that keeps CTS high this long is gone, bytes are dropped until it clears
+#define UART_CTS_TIMEOUT_MS 100
+// replies queued while the transmitter is busy, a full queue makes UartSendChar wait
+#define UART_TX_BUFFER_SIZE 64
+
+// RTS/CTS are active low
+#if UART_FLOW_CONTROL
+#define UART_RTS_TRIS TRISDbits.TRISD0
+#define UART_RTS_LAT LATDbits.LATD0
+#define UART_CTS_TRIS TRISDbits.TRISD1
+#define UART_CTS_PORT PORTDbits.RD1
+#define UartRtsReady() (UART_RTS_LAT = 0)
+#define UartRtsHold() (UART_RTS_LAT = 1)
+#define UartCtsClear() (UART_CTS_PORT == 0)
+#else
+#define UartRtsReady() ((void)0)
+#define UartRtsHold() ((void)0)
+#define UartCtsClear() 1
+#endif
 
 void UartInitialize(IntPriority tx_priority, IntPriority rx_priority);
 void UartClearBuffer(void);
 void UartSendChar(char c);
+void UartTxPoll(void);
+unsigned char UartTxPending(void);
 void UartSendString(char *str);
 void UartReceiveChar(void);
+unsigned char UartReceiveByte(void);
+void UartBufferChar(char c);
+void UartSetEcho(unsigned char on);
 char UartGetChar(void);
 void UartSendInt(int num);
+void UartSendUnsigned(unsigned int num);
+void UartSendLong(long num);
 int UartBufferEndsWith(const char *str);
 void UartCopyBufferToString(char *str);
+unsigned int UartGetOverrunCount(void);
+unsigned int UartGetDroppedCount(void);
+unsigned int UartGetCtsTimeoutCount(void);
+unsigned char UartLineOverflowed(void);
 #endif
\ No newline at end of file